@@ -0,0 +1,174 @@
+package FTLogo
+
+/*
+#include "tib/ftl.h"
+
+// Acknowledges the messages flagged in ack and destroys every message, returning how many
+// acknowledgements failed; the text of the first failure is copied to text
+static int ackBatch(tibEx ex, tibMessage *msgs, const char *ack, int n, char *text, int textLen)
+{
+    int i, failed = 0;
+
+    for (i = 0; i < n; i++)
+    {
+        if (ack[i])
+        {
+            tibMessage_Acknowledge(ex, msgs[i]);
+            if (tibEx_GetErrorCode(ex) != TIB_OK)
+            {
+                if (failed++ == 0)
+                    tibEx_ToString(ex, text, textLen);
+                tibEx_Clear(ex);
+            }
+        }
+        tibMessage_Destroy(ex, msgs[i]);
+        tibEx_Clear(ex);
+    }
+    return failed;
+}
+*/
+import "C"
+
+import (
+	"sync"
+	"time"
+)
+
+const (
+	ackBatchSize  = 256
+	ackMaxUnacked = 4096
+	ackInterval   = 10 * time.Millisecond
+)
+
+// pendingAck is a message released to the application, to acknowledge or just destroy
+type pendingAck struct {
+	msg C.tibMessage
+	ack bool
+}
+
+// acker acknowledges completed messages of a durable in batches on its own thread.
+// At most maxUnacked messages wait for acknowledgement; beyond that, add blocks the
+// dispatch thread so the durable stops delivering until acknowledgements catch up.
+type acker struct {
+	name    string
+	pending chan pendingAck
+	batch   int
+	done    chan struct{}
+
+	// release acknowledges or destroys a batch of messages; ackBatch outside of tests
+	release func(batch []pendingAck)
+
+	// window holds a slot per message not yet acknowledged, including those the run
+	// thread has taken from pending but not flushed
+	window chan struct{}
+
+	// mu keeps close from closing pending while a late handler is adding to it
+	mu     sync.RWMutex
+	closed bool
+}
+
+func newAcker(name string, batch, maxUnacked int) *acker {
+	if batch <= 0 {
+		batch = ackBatchSize
+	}
+	if maxUnacked <= 0 {
+		maxUnacked = ackMaxUnacked
+	}
+	if batch > maxUnacked {
+		batch = maxUnacked
+	}
+
+	a := &acker{
+		name:    name,
+		pending: make(chan pendingAck, maxUnacked),
+		batch:   batch,
+		done:    make(chan struct{}),
+		window:  make(chan struct{}, maxUnacked),
+	}
+	a.release = a.ackBatch
+	go a.run()
+	return a
+}
+
+// add queues a message whose flow completed; ack false destroys it unacknowledged
+// so the durable redelivers it
+func (a *acker) add(msg C.tibMessage, ack bool) {
+	a.mu.RLock()
+	defer a.mu.RUnlock()
+
+	if a.closed {
+		a.release([]pendingAck{{msg: msg}})
+		return
+	}
+	a.window <- struct{}{}
+	a.pending <- pendingAck{msg: msg, ack: ack}
+}
+
+// close acknowledges what is still queued and stops the acker
+func (a *acker) close() {
+	a.mu.Lock()
+	a.closed = true
+	close(a.pending)
+	a.mu.Unlock()
+	<-a.done
+}
+
+func (a *acker) run() {
+	defer close(a.done)
+
+	batch := make([]pendingAck, 0, a.batch)
+	timer := time.NewTimer(ackInterval)
+	defer timer.Stop()
+
+	flush := func() {
+		if len(batch) == 0 {
+			return
+		}
+		a.release(batch)
+		for range batch {
+			<-a.window
+		}
+		batch = batch[:0]
+	}
+
+	for {
+		select {
+		case p, ok := <-a.pending:
+			if !ok {
+				flush()
+				return
+			}
+			batch = append(batch, p)
+			if len(batch) < a.batch {
+				continue
+			}
+		case <-timer.C:
+		}
+		flush()
+		timer.Reset(ackInterval)
+	}
+}
+
+// ackBatch acknowledges the messages of batch flagged ack and destroys all of them
+func (a *acker) ackBatch(batch []pendingAck) {
+	ex := C.tibEx_Create()
+	defer C.tibEx_Destroy(ex)
+
+	msgs := make([]C.tibMessage, len(batch))
+	acks := make([]C.char, len(batch))
+	for i, p := range batch {
+		msgs[i] = p.msg
+		acks[i] = boolChar(p.ack)
+	}
+	text := make([]C.char, 1024)
+	if failed := C.ackBatch(ex, &msgs[0], &acks[0], C.int(len(msgs)), &text[0], C.int(len(text))); failed > 0 {
+		log.Errorf("Unable to acknowledge %d messages of durable [%s]: %s", failed, a.name, C.GoString(&text[0]))
+	}
+}
+
+func boolChar(b bool) C.char {
+	if b {
+		return 1
+	}
+	return 0
+}
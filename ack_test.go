@@ -0,0 +1,58 @@
+package FTLogo
+
+import (
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func TestAckerWindow(t *testing.T) {
+	a := newAcker("durable", 8, 4)
+	assert.Equal(t, 4, a.batch)
+	assert.Equal(t, 4, cap(a.pending))
+	assert.Equal(t, 4, cap(a.window))
+	a.close()
+
+	// batches are recorded instead of reaching the client library
+	var released, acked, largest int
+	a = &acker{name: "durable", pending: make(chan pendingAck, 4), batch: 4, done: make(chan struct{}), window: make(chan struct{}, 4)}
+	a.release = func(batch []pendingAck) {
+		if len(batch) > largest {
+			largest = len(batch)
+		}
+		for _, p := range batch {
+			released++
+			if p.ack {
+				acked++
+			}
+		}
+	}
+	go a.run()
+
+	// more messages than the window: add blocks until the acker drains
+	for i := 0; i < 100; i++ {
+		a.add(nil, i%10 != 0)
+	}
+	a.close()
+	assert.Equal(t, 0, len(a.window))
+	assert.Equal(t, 100, released)
+	assert.Equal(t, 90, acked)
+	assert.True(t, largest <= 4)
+
+	// a handler finishing after close has its message destroyed unacknowledged
+	a.add(nil, true)
+	assert.Equal(t, 101, released)
+	assert.Equal(t, 90, acked)
+}
+
+func TestSubscriberConfigValidate(t *testing.T) {
+	config := SubscriberConfig{Endpoint: "ep", ExplicitAck: true}
+	assert.NotNil(t, config.validate())
+	config.Durable = "orders"
+	assert.Nil(t, config.validate())
+
+	// partitioning a durable would consume the other members' messages unprocessed
+	config.Group = "workers"
+	config.PartitionKey = "id"
+	assert.NotNil(t, config.validate())
+}
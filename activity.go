@@ -4,74 +4,13 @@ package FTLogo
 #cgo CFLAGS: -std=gnu11 -m64 -O2 -Wall -Wshadow -I/opt/tibco/ftl/5.2/lib/include
 #cgo LDFLAGS: -L/opt/tibco/ftl/5.2/lib -ltib -ltibutil
 
-#include <stdlib.h>
-#include <stdio.h>
-#include <stddef.h>
-#include <string.h>
 #include "tib/ftl.h"
-
-#define CHECK(ex) \
-{                              \
-    if(tibEx_GetErrorCode(ex)) \
-    {                          \
-       char exStr[1024];       \
-       fprintf(stderr, "%s: %d\n", __FILE__, __LINE__); \
-       tibEx_ToString(ex, exStr, sizeof(exStr));        \
-       fprintf(stderr, "%s\n", exStr);                  \
-       tib_Close(ex);                                   \
-       exit(-1);                                        \
-    }                                                   \
-}
-
-int sendFTLMessage(char server[], char messageinput[])
-{
-    tibEx               ex;
-    tibRealm            realm = NULL;
-    tibPublisher        pub;
-    tibMessage          msg;
-
-    ex = tibEx_Create();
-
-    tib_Open(ex, TIB_COMPATIBILITY_VERSION);
-
-    // connect to the realmserver to get a config, 'default' app is returned if the appName is NULL.
-    realm = tibRealm_Connect(ex, server, NULL, NULL);
-
-    // Create the publisher object
-    pub = tibPublisher_Create(ex, realm, NULL, NULL);
-    CHECK(ex);
-
-    // create the hello world msg.
-    msg = tibMessage_Create(ex, realm, NULL);
-    tibMessage_SetString(ex, msg, "type", "hello");
-    tibMessage_SetString(ex, msg, "message", messageinput);
-
-    // send hello world ftl msg
-    printf("sending: \'%s\' \n",messageinput);
-    fflush(stdout);
-
-    tibPublisher_Send(ex, pub, msg);
-
-    // cleanup
-    tibMessage_Destroy(ex, msg);
-
-    tibPublisher_Close(ex, pub);
-    tibRealm_Close(ex, realm);
-
-    tib_Close(ex);
-
-    // Check if it worked before destroying the exception
-    CHECK(ex);
-    tibEx_Destroy(ex);
-
-    return 0;
-}
-
 */
 import "C"
 
 import (
 	"fmt"
+	"strconv"
 
 	"github.com/TIBCOSoftware/flogo-lib/core/activity"
 	"github.com/TIBCOSoftware/flogo-lib/logger"
@@ -86,8 +25,10 @@ type MyActivity struct {
 	metadata *activity.Metadata
 }
 
-// NewActivity creates a new activity
+// NewActivity creates a new activity, starting the connections listed in FTLOGO_WARMUP
+// in the background
 func NewActivity(metadata *activity.Metadata) activity.Activity {
+	startWarmup()
 	return &MyActivity{metadata: metadata}
 }
 
@@ -100,22 +41,117 @@ func (a *MyActivity) Metadata() *activity.Metadata {
 
 // Eval implements activity.Activity.Eval
 func (a *MyActivity) Eval(context activity.Context) (done bool, err error) {
+	operation := inputString(context, "operation")
+
+	switch operation {
+	case "", "send":
+		return a.evalSend(context)
+	case "mapScan":
+		return evalMapScan(context)
+	case "mapGet":
+		return evalMapGet(context)
+	case "mapSet":
+		return evalMapSet(context)
+	case "mapRemove":
+		return evalMapRemove(context)
+	case "mapUpdate":
+		return evalMapUpdate(context)
+	case "lockAcquire":
+		return evalLockAcquire(context)
+	case "lockRelease":
+		return evalLockRelease(context)
+	case "subscribe":
+		return evalSubscribe(context)
+	case "unsubscribe":
+		return evalUnsubscribe(context)
+	}
+	return false, fmt.Errorf("unknown operation [%s]", operation)
+}
+
+// evalSend publishes the message input to the realm at url, or to every realm of urls at once.
+// While a realm cannot be reached, messages are kept in the spool under spoolDir, if set, and
+// replayed in order later.
+func (a *MyActivity) evalSend(context activity.Context) (done bool, err error) {
 	// Get the activity data from the context
-	url := context.GetInput("url").(string)
+	url := inputRealm(context)
 	message := context.GetInput("message").(string)
+	urls, err := inputStrings(context, "urls")
+	if err != nil {
+		return false, err
+	}
 
 	// Use the log object to log the greeting
 	log.Debugf("The Flogo engine sent the message [%s] to the url [%s]", message, url)
 
-	// Set the result as part of the context
-	context.SetOutput("result", "The Flogo engine sent the message "+message+" to the url"+url)
+	if len(urls) > 0 {
+		return evalFanOut(context, urls, message)
+	}
+	return evalPooledSend(context, url, message)
+}
 
-	//C Code
-	fmt.Println("I am in Go code now!")
-	//C.inC()
-	//C.sendFTLMessage(C.CString("http://localhost:8080"), C.CString("This is a FTL message sent from Flogo"))
-	C.sendFTLMessage(C.CString(url), C.CString(message))
+// inputString returns a string input, or "" when it is not set
+func inputString(context activity.Context, name string) string {
+	value, _ := context.GetInput(name).(string)
+	return value
+}
+
+// inputRealm returns the realm url of the url input, failing over to secondaryUrl if set
+func inputRealm(context activity.Context) string {
+	warm, _ := context.GetInput("warmStandby").(bool)
+	return RealmURL(inputString(context, "url"), inputString(context, "secondaryUrl"), warm)
+}
+
+// inputStrings returns an array input of strings
+func inputStrings(context activity.Context, name string) ([]string, error) {
+	switch value := context.GetInput(name).(type) {
+	case nil:
+		return nil, nil
+	case []string:
+		return value, nil
+	case []interface{}:
+		values := make([]string, len(value))
+		for i, v := range value {
+			s, ok := v.(string)
+			if !ok {
+				return nil, fmt.Errorf("input [%s] element %d is not a string", name, i)
+			}
+			values[i] = s
+		}
+		return values, nil
+	}
+	return nil, fmt.Errorf("input [%s] must be an array of strings", name)
+}
+
+// inputInt returns a numeric input, or def when it is not set
+func inputInt(context activity.Context, name string, def int) int {
+	switch value := context.GetInput(name).(type) {
+	case int:
+		return value
+	case int64:
+		return int(value)
+	case float64:
+		return int(value)
+	case string:
+		if n, err := strconv.Atoi(value); err == nil {
+			return n
+		}
+	}
+	return def
+}
 
-	// Signal to the Flogo engine that the activity is completed
-	return true, nil
+// inputFloat returns a numeric input, or def when it is not set
+func inputFloat(context activity.Context, name string, def float64) float64 {
+	switch value := context.GetInput(name).(type) {
+	case int:
+		return float64(value)
+	case int64:
+		return float64(value)
+	case float64:
+		return value
+	case string:
+		if f, err := strconv.ParseFloat(value, 64); err == nil {
+			return f
+		}
+	}
+	return def
 }
@@ -58,3 +58,20 @@ func TestEval(t *testing.T) {
 	result := tc.GetOutput("result")
 	assert.Equal(t, result, "The Flogo engine sent the message This is a FTL message sent from Flogo to the urlhttp://192.168.1.65:8080")
 }
+
+func TestEvalFanOut(t *testing.T) {
+	act := NewActivity(getActivityMetadata())
+	tc := test.NewTestActivityContext(getActivityMetadata())
+
+	tc.SetInput("urls", []interface{}{"http://192.168.1.65:8080", "http://192.168.1.66:8080"})
+	tc.SetInput("message", "This is a FTL message sent from Flogo")
+	done, err := act.Eval(tc)
+	assert.Nil(t, err)
+	assert.True(t, done)
+
+	assert.Equal(t, "message sent to 2 of 2 realms", tc.GetOutput("result"))
+	outcomes := tc.GetOutput("data").([]map[string]interface{})
+	assert.Len(t, outcomes, 2)
+	assert.Equal(t, "http://192.168.1.66:8080", outcomes[1]["url"])
+	assert.Equal(t, true, outcomes[1]["sent"])
+}
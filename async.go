@@ -0,0 +1,218 @@
+package FTLogo
+
+/*
+#include <stdlib.h>
+#include "ftlogo.h"
+
+static tibPublisher createReleasingPublisher(tibEx ex, tibRealm realm, const char *endpoint)
+{
+    tibProperties   props;
+    tibPublisher    pub;
+
+    props = tibProperties_Create(ex);
+    tibProperties_SetBoolean(ex, props, TIB_PUBLISHER_PROPERTY_BOOL_RELEASE_MSGS_TO_SEND, tibtrue);
+    pub = tibPublisher_Create(ex, realm, endpoint, props);
+    tibProperties_Destroy(ex, props);
+    return pub;
+}
+
+// Builds a message from each of the n encodings in data and sends them in one call.
+// The publisher releases messages to the library, so nothing is destroyed after the send.
+// Returns -1 when an encoding is malformed or a message could not be built.
+static int sendReleased(tibEx ex, tibRealm realm, tibPublisher pub, const char *data, int len,
+                        tibMessage *msgs, int n)
+{
+    ftlogoReader    r = { data, len, 0 };
+    int             i, bad = 0;
+
+    for (i = 0; i < n; i++)
+    {
+        msgs[i] = ftlogoMessage_Decode(ex, realm, &r, &bad);
+        if (bad || msgs[i] == NULL || tibEx_GetErrorCode(ex) != TIB_OK)
+        {
+            // still ours: the send that would have released them never happened
+            while (i-- > 0)
+                tibMessage_Destroy(ex, msgs[i]);
+            return -1;
+        }
+    }
+    tibPublisher_SendMessages(ex, pub, n, msgs);
+    return 0;
+}
+*/
+import "C"
+
+import (
+	"fmt"
+	"runtime"
+	"sync"
+	"unsafe"
+)
+
+const (
+	asyncQueueSize = 8192
+	asyncBatchSize = 128
+)
+
+// asyncSender publishes queued messages from a locked thread through a publisher that
+// releases sent messages to the library, so the sender neither destroys nor recycles them
+type asyncSender struct {
+	conn     *realmConn
+	endpoint string
+	pub      C.tibPublisher
+	queue    chan asyncMessage
+
+	// mu keeps retire from closing queue while a flow is sending to it
+	mu      sync.RWMutex
+	retired bool
+}
+
+// asyncMessage is a queued encoding with the spool that takes it if the send fails
+type asyncMessage struct {
+	data []byte
+	sp   *spool
+}
+
+var (
+	asyncSendersMu sync.Mutex
+	asyncSenders   = make(map[string]*asyncSender)
+)
+
+func getAsyncSender(conn *realmConn, endpoint string) (*asyncSender, error) {
+	asyncSendersMu.Lock()
+	defer asyncSendersMu.Unlock()
+
+	key := conn.url + "|" + endpoint
+	if s, ok := asyncSenders[key]; ok {
+		return s, nil
+	}
+	if err := conn.checkLive(); err != nil {
+		return nil, err
+	}
+
+	ex := C.tibEx_Create()
+	defer C.tibEx_Destroy(ex)
+
+	cendpoint := cStringOrNil(endpoint)
+	defer C.free(unsafe.Pointer(cendpoint))
+
+	s := &asyncSender{conn: conn, endpoint: endpoint, queue: make(chan asyncMessage, asyncQueueSize)}
+	s.pub = C.createReleasingPublisher(ex, conn.realm, cendpoint)
+	if err := exError(ex); err != nil {
+		return nil, err
+	}
+	go s.run()
+
+	asyncSenders[key] = s
+	return s, nil
+}
+
+// send encodes fields and queues them, blocking only while the queue is full. If the send
+// fails later, the message goes to sp when it is set.
+func (s *asyncSender) send(fields map[string]interface{}, sp *spool) (bool, error) {
+	data, err := encodeMessage(nil, fields)
+	if err != nil {
+		return false, err
+	}
+	s.mu.RLock()
+	defer s.mu.RUnlock()
+
+	if s.retired {
+		return false, fmt.Errorf("async sender of endpoint [%s] was retired with its realm connection", s.endpoint)
+	}
+	s.queue <- asyncMessage{data: data, sp: sp}
+	return true, nil
+}
+
+// retireAsyncSenders stops the senders of conn once they have sent what is queued
+func retireAsyncSenders(conn *realmConn) {
+	asyncSendersMu.Lock()
+	var retired []*asyncSender
+	for key, s := range asyncSenders {
+		if s.conn == conn {
+			delete(asyncSenders, key)
+			retired = append(retired, s)
+		}
+	}
+	asyncSendersMu.Unlock()
+
+	for _, s := range retired {
+		s.mu.Lock()
+		s.retired = true
+		close(s.queue)
+		s.mu.Unlock()
+	}
+}
+
+// drain appends first and whatever else has queued up, up to asyncBatchSize messages,
+// to msgs
+func (s *asyncSender) drain(msgs []asyncMessage, first asyncMessage) []asyncMessage {
+	msgs = append(msgs, first)
+	for len(msgs) < asyncBatchSize {
+		select {
+		case m := <-s.queue:
+			msgs = append(msgs, m)
+		default:
+			return msgs
+		}
+	}
+	return msgs
+}
+
+// spool keeps the messages of a failed send that have a spool, reporting how many it took
+func (s *asyncSender) spool(msgs []asyncMessage) int {
+	spooled := 0
+	for _, m := range msgs {
+		if m.sp == nil {
+			continue
+		}
+		if err := m.sp.append(s.endpoint, m.data); err != nil {
+			log.Errorf("Unable to spool a failed message to endpoint [%s]: %v", s.endpoint, err)
+			continue
+		}
+		spooled++
+	}
+	return spooled
+}
+
+// run sends whatever has queued up since the last send in one tibPublisher_SendMessages call
+func (s *asyncSender) run() {
+	runtime.LockOSThread()
+	defer runtime.UnlockOSThread()
+
+	ex := C.tibEx_Create()
+	defer C.tibEx_Destroy(ex)
+
+	msgs := (*C.tibMessage)(C.malloc(C.size_t(asyncBatchSize) * C.size_t(unsafe.Sizeof(C.tibMessage(nil)))))
+	defer C.free(unsafe.Pointer(msgs))
+
+	var queued []asyncMessage
+	var batch []byte
+	for m := range s.queue {
+		queued = s.drain(queued[:0], m)
+		n := len(queued)
+		batch = batch[:0]
+		for _, q := range queued {
+			batch = append(batch, q.data...)
+		}
+
+		// the queue absorbs bursts while the sender waits out the rate limits
+		takeRate(s.conn.url, s.endpoint, n)
+
+		cdata := C.CBytes(batch)
+		rc := C.sendReleased(ex, s.conn.realm, s.pub, (*C.char)(cdata), C.int(len(batch)), msgs, C.int(n))
+		C.free(cdata)
+
+		if rc < 0 {
+			err := exError(ex)
+			if err == nil {
+				err = fmt.Errorf("malformed message encoding")
+			}
+			log.Errorf("Unable to build %d messages for endpoint [%s], spooled %d: %v", n, s.endpoint, s.spool(queued), err)
+		} else if err := exError(ex); err != nil {
+			log.Errorf("Unable to send %d messages to endpoint [%s], spooled %d: %v", n, s.endpoint, s.spool(queued), err)
+		}
+		C.tibEx_Clear(ex)
+	}
+	C.tibPublisher_Close(ex, s.pub)
+}
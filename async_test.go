@@ -0,0 +1,71 @@
+package FTLogo
+
+import (
+	"io/ioutil"
+	"os"
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func TestAsyncSenderDrain(t *testing.T) {
+	s := &asyncSender{endpoint: "ep", queue: make(chan asyncMessage, 200)}
+	for i := 0; i < 200; i++ {
+		sent, err := s.send(map[string]interface{}{"n": int64(i)}, nil)
+		assert.Nil(t, err)
+		assert.True(t, sent)
+	}
+
+	// a batch takes what has queued up, in order, up to the batch size
+	msgs := s.drain(nil, <-s.queue)
+	assert.Len(t, msgs, asyncBatchSize)
+	for i, m := range msgs {
+		fields, err := decodeMessage(m.data)
+		assert.Nil(t, err)
+		assert.Equal(t, int64(i), fields["n"])
+	}
+
+	// the next batch reuses the slice and stops at an empty queue
+	msgs = s.drain(msgs[:0], <-s.queue)
+	assert.Len(t, msgs, 200-asyncBatchSize)
+	fields, err := decodeMessage(msgs[0].data)
+	assert.Nil(t, err)
+	assert.Equal(t, int64(asyncBatchSize), fields["n"])
+	assert.Len(t, s.queue, 0)
+}
+
+func TestAsyncSenderRejectsUnencodable(t *testing.T) {
+	s := &asyncSender{endpoint: "ep", queue: make(chan asyncMessage, 1)}
+	sent, err := s.send(map[string]interface{}{"bad": struct{}{}}, nil)
+	assert.NotNil(t, err)
+	assert.False(t, sent)
+	assert.Len(t, s.queue, 0)
+}
+
+func TestAsyncSenderSpoolsFailures(t *testing.T) {
+	dir, err := ioutil.TempDir("", "spool")
+	assert.Nil(t, err)
+	defer os.RemoveAll(dir)
+
+	sp := &spool{dir: dir, budget: 1 << 20, commit: make(chan struct{}, 1)}
+	go sp.committer()
+
+	// only the messages sent with a spool are kept after a failed send
+	s := &asyncSender{endpoint: "ep", queue: make(chan asyncMessage, 4)}
+	s.send(map[string]interface{}{"n": int64(1)}, sp)
+	s.send(map[string]interface{}{"n": int64(2)}, nil)
+	s.send(map[string]interface{}{"n": int64(3)}, sp)
+	assert.Equal(t, 2, s.spool(s.drain(nil, <-s.queue)))
+	assert.True(t, sp.pending())
+
+	segments, err := sp.segments()
+	assert.Nil(t, err)
+	assert.Len(t, segments, 1)
+	err = readSpoolSegment(segments[0].path, func(entries []spoolEntry, torn bool) {
+		assert.Len(t, entries, 2)
+		fields, err := decodeMessage(entries[1].data)
+		assert.Nil(t, err)
+		assert.Equal(t, int64(3), fields["n"])
+	})
+	assert.Nil(t, err)
+}
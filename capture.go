@@ -0,0 +1,198 @@
+package FTLogo
+
+import (
+	"bufio"
+	"encoding/binary"
+	"errors"
+	"hash/crc32"
+	"io"
+	"os"
+	"sync"
+	"time"
+)
+
+// Capture records the messages of a set of endpoints to a file, one spool record per message
+// stamped with its receive time, so a replay can reproduce the traffic later
+type Capture struct {
+	mu    sync.Mutex
+	f     *os.File
+	w     *bufio.Writer
+	seq   uint64
+	err   error
+	subs  []*Subscriber
+	count int
+}
+
+// StartCapture subscribes to every endpoint of the realm at url, or only to the messages
+// matching matcher when it is set, and appends what arrives to the file at path
+func StartCapture(url string, endpoints []string, matcher, path string) (*Capture, error) {
+	f, err := os.Create(path)
+	if err != nil {
+		return nil, err
+	}
+	c := &Capture{f: f, w: bufio.NewWriter(f)}
+
+	for _, endpoint := range endpoints {
+		endpoint := endpoint
+		sub, err := NewSubscriber(SubscriberConfig{URL: url, Endpoint: endpoint, Matcher: matcher}, func(fields map[string]interface{}) error {
+			return c.record(endpoint, fields, time.Now())
+		})
+		if err != nil {
+			c.Close()
+			return nil, err
+		}
+		c.mu.Lock()
+		c.subs = append(c.subs, sub)
+		c.mu.Unlock()
+	}
+	return c, nil
+}
+
+func (c *Capture) record(endpoint string, fields map[string]interface{}, at time.Time) error {
+	data, err := encodeMessage(nil, fields)
+	if err != nil {
+		return err
+	}
+	record := spoolRecord(endpoint, data)
+
+	c.mu.Lock()
+	defer c.mu.Unlock()
+
+	if c.err != nil {
+		return c.err
+	}
+	c.seq++
+	sealSpoolRecord(record, c.seq, at)
+	if _, c.err = c.w.Write(record); c.err == nil {
+		c.count++
+	}
+	return c.err
+}
+
+// Count returns the number of messages captured so far
+func (c *Capture) Count() int {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	return c.count
+}
+
+// Close stops the subscribers and flushes the capture file
+func (c *Capture) Close() error {
+	c.mu.Lock()
+	subs := c.subs
+	c.subs = nil
+	c.mu.Unlock()
+
+	for _, sub := range subs {
+		sub.Close()
+	}
+
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if err := c.w.Flush(); err != nil && c.err == nil {
+		c.err = err
+	}
+	if err := c.f.Close(); err != nil && c.err == nil {
+		c.err = err
+	}
+	return c.err
+}
+
+var errCaptureCorrupt = errors.New("capture record fails its checksum")
+
+// readCaptureRecord reads the next record of a capture, io.EOF at its end
+func readCaptureRecord(r *bufio.Reader) (spoolEntry, error) {
+	header := make([]byte, spoolHeaderSize)
+	if _, err := io.ReadFull(r, header); err != nil {
+		return spoolEntry{}, err
+	}
+	n := int(binary.LittleEndian.Uint32(header))
+	if n < 4 {
+		return spoolEntry{}, errCaptureCorrupt
+	}
+	payload := make([]byte, n)
+	if _, err := io.ReadFull(r, payload); err != nil {
+		return spoolEntry{}, io.ErrUnexpectedEOF
+	}
+	e := int(binary.LittleEndian.Uint32(payload))
+	if crc32.Checksum(payload, crc32c) != binary.LittleEndian.Uint32(header[4:]) || 4+e > n {
+		return spoolEntry{}, errCaptureCorrupt
+	}
+	return spoolEntry{
+		seq:      binary.LittleEndian.Uint64(header[8:]),
+		at:       time.Unix(0, int64(binary.LittleEndian.Uint64(header[16:]))),
+		endpoint: string(payload[4 : 4+e]),
+		data:     payload[4+e:],
+		size:     spoolHeaderSize + n,
+	}, nil
+}
+
+// readCapture hands every record of a capture to fn in order
+func readCapture(r io.Reader, fn func(e spoolEntry) error) error {
+	br := bufio.NewReaderSize(r, 1<<20)
+	for {
+		e, err := readCaptureRecord(br)
+		if err == io.EOF {
+			return nil
+		}
+		if err != nil {
+			return err
+		}
+		if err := fn(e); err != nil {
+			return err
+		}
+	}
+}
+
+// replayPacer spaces replayed messages by their captured gaps divided by speed; a speed of
+// zero or less sends as fast as possible
+type replayPacer struct {
+	speed float64
+	first time.Time
+	start time.Time
+}
+
+// wait returns how long to sleep before sending a message captured at at
+func (p *replayPacer) wait(at, now time.Time) time.Duration {
+	if p.speed <= 0 {
+		return 0
+	}
+	if p.start.IsZero() {
+		p.first, p.start = at, now
+		return 0
+	}
+	due := p.start.Add(time.Duration(float64(at.Sub(p.first)) / p.speed))
+	if d := due.Sub(now); d > 0 {
+		return d
+	}
+	return 0
+}
+
+// ReplayCapture republishes the capture at path to the realm at url through the pooled
+// publishers, at speed times the captured rate, and returns the number of messages sent.
+// Messages are sent late rather than dropped when the realm cannot keep the pace.
+func ReplayCapture(url, path string, speed float64) (int, error) {
+	conn, err := getRealm(url)
+	if err != nil {
+		return 0, err
+	}
+	f, err := os.Open(path)
+	if err != nil {
+		return 0, err
+	}
+	defer f.Close()
+
+	pacer := &replayPacer{speed: speed}
+	sent := 0
+	err = readCapture(f, func(e spoolEntry) error {
+		if d := pacer.wait(e.at, time.Now()); d > 0 {
+			time.Sleep(d)
+		}
+		if err := publishEncoded(conn, e.endpoint, e.data); err != nil {
+			return err
+		}
+		sent++
+		return nil
+	})
+	return sent, err
+}
@@ -0,0 +1,62 @@
+package FTLogo
+
+import (
+	"bufio"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"testing"
+	"time"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func TestCaptureRoundTrip(t *testing.T) {
+	dir, err := ioutil.TempDir("", "capture")
+	assert.Nil(t, err)
+	defer os.RemoveAll(dir)
+
+	path := filepath.Join(dir, "traffic.cap")
+	f, err := os.Create(path)
+	assert.Nil(t, err)
+	c := &Capture{f: f, w: bufio.NewWriter(f)}
+
+	at := time.Unix(1500000000, 0)
+	assert.Nil(t, c.record("orders", map[string]interface{}{"id": int64(1)}, at))
+	assert.Nil(t, c.record("quotes", map[string]interface{}{"px": 1.5}, at.Add(time.Second)))
+	assert.Nil(t, c.Close())
+	assert.Equal(t, 2, c.Count())
+
+	in, err := os.Open(path)
+	assert.Nil(t, err)
+	defer in.Close()
+
+	var entries []spoolEntry
+	assert.Nil(t, readCapture(in, func(e spoolEntry) error {
+		entries = append(entries, e)
+		return nil
+	}))
+	assert.Len(t, entries, 2)
+	assert.Equal(t, "quotes", entries[1].endpoint)
+	assert.Equal(t, uint64(2), entries[1].seq)
+	assert.True(t, at.Add(time.Second).Equal(entries[1].at))
+
+	fields, err := decodeMessage(entries[0].data)
+	assert.Nil(t, err)
+	assert.Equal(t, int64(1), fields["id"])
+}
+
+func TestReplayPacer(t *testing.T) {
+	at := time.Unix(1500000000, 0)
+	now := time.Now()
+
+	p := &replayPacer{speed: 2}
+	assert.Equal(t, time.Duration(0), p.wait(at, now))
+	assert.Equal(t, time.Second, p.wait(at.Add(2*time.Second), now))
+	// a replay that fell behind sends at once
+	assert.Equal(t, time.Duration(0), p.wait(at.Add(2*time.Second), now.Add(3*time.Second)))
+
+	max := &replayPacer{}
+	max.wait(at, now)
+	assert.Equal(t, time.Duration(0), max.wait(at.Add(time.Hour), now))
+}
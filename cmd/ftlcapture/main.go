@@ -0,0 +1,55 @@
+// Command ftlcapture records the messages published on FTL endpoints to a capture file
+// that ftlreplay can send again, for reproducing production traffic against another realm.
+//
+//	ftlcapture -url http://localhost:8080 -endpoints orders,quotes -out traffic.cap
+package main
+
+import (
+	"flag"
+	"fmt"
+	"os"
+	"os/signal"
+	"strings"
+	"syscall"
+	"time"
+
+	"github.com/kawatoto/FTLogo"
+)
+
+func main() {
+	url := flag.String("url", "http://localhost:8080", "realm server url")
+	endpoints := flag.String("endpoints", "", "comma separated endpoints to capture")
+	matcher := flag.String("matcher", "", "content matcher applied to every endpoint")
+	out := flag.String("out", "capture.ftl", "capture file")
+	duration := flag.Duration("duration", 0, "stop after this long, 0 to run until interrupted")
+	flag.Parse()
+
+	if *endpoints == "" {
+		fmt.Fprintln(os.Stderr, "ftlcapture: -endpoints is required")
+		os.Exit(2)
+	}
+
+	capture, err := FTLogo.StartCapture(*url, strings.Split(*endpoints, ","), *matcher, *out)
+	if err != nil {
+		fmt.Fprintln(os.Stderr, "ftlcapture:", err)
+		os.Exit(1)
+	}
+
+	stop := make(chan os.Signal, 1)
+	signal.Notify(stop, os.Interrupt, syscall.SIGTERM)
+	var timeout <-chan time.Time
+	if *duration > 0 {
+		timeout = time.After(*duration)
+	}
+	select {
+	case <-stop:
+	case <-timeout:
+	}
+
+	err = capture.Close()
+	fmt.Printf("captured %d messages to %s\n", capture.Count(), *out)
+	if err != nil {
+		fmt.Fprintln(os.Stderr, "ftlcapture:", err)
+		os.Exit(1)
+	}
+}
@@ -0,0 +1,34 @@
+// Command ftlload publishes generated messages at a fixed rate and reports their end-to-end
+// latency percentiles, both as measured and corrected for coordinated omission.
+//
+//	ftlload -url http://localhost:8080 -endpoint load -rate 10000 -size 512 -duration 1m
+package main
+
+import (
+	"flag"
+	"fmt"
+	"os"
+	"time"
+
+	"github.com/kawatoto/FTLogo"
+)
+
+func main() {
+	var config FTLogo.LoadConfig
+	flag.StringVar(&config.URL, "url", "http://localhost:8080", "realm server url")
+	flag.StringVar(&config.Endpoint, "endpoint", "", "endpoint to publish and subscribe on")
+	flag.IntVar(&config.Rate, "rate", 1000, "messages per second, 0 for as fast as possible")
+	flag.IntVar(&config.Concurrency, "concurrency", 4, "concurrent senders")
+	flag.IntVar(&config.Size, "size", 256, "approximate message payload in bytes")
+	flag.IntVar(&config.Fields, "fields", 4, "payload fields per message")
+	flag.DurationVar(&config.Duration, "duration", 30*time.Second, "length of the run")
+	flag.DurationVar(&config.Drain, "drain", 2*time.Second, "wait for messages in flight after the run")
+	flag.Parse()
+
+	report, err := FTLogo.RunLoad(config)
+	if err != nil {
+		fmt.Fprintln(os.Stderr, "ftlload:", err)
+		os.Exit(1)
+	}
+	fmt.Println(report)
+}
@@ -0,0 +1,30 @@
+// Command ftlreplay republishes a capture written by ftlcapture, keeping the captured
+// message gaps at 1x, compressing them at a higher speed, or sending flat out.
+//
+//	ftlreplay -url http://staging:8080 -in traffic.cap -speed 4
+package main
+
+import (
+	"flag"
+	"fmt"
+	"os"
+	"time"
+
+	"github.com/kawatoto/FTLogo"
+)
+
+func main() {
+	url := flag.String("url", "http://localhost:8080", "realm server url")
+	in := flag.String("in", "capture.ftl", "capture file")
+	speed := flag.Float64("speed", 1, "replay speed relative to the capture, 0 for as fast as possible")
+	flag.Parse()
+
+	start := time.Now()
+	sent, err := FTLogo.ReplayCapture(*url, *in, *speed)
+	elapsed := time.Since(start)
+	fmt.Printf("replayed %d messages in %v (%.0f msg/s)\n", sent, elapsed, float64(sent)/elapsed.Seconds())
+	if err != nil {
+		fmt.Fprintln(os.Stderr, "ftlreplay:", err)
+		os.Exit(1)
+	}
+}
@@ -0,0 +1,170 @@
+package FTLogo
+
+import (
+	"bytes"
+	"compress/flate"
+	"fmt"
+	"io"
+	"io/ioutil"
+	"sync"
+)
+
+// Header fields of a compressed message: the codec, and the names of the opaque and of the
+// string fields it compressed. A string field travels as an opaque and is restored on receipt.
+const (
+	codecField          = "ftlogoCodec"
+	compressedField     = "ftlogoCompressed"
+	compressedTextField = "ftlogoCompressedText"
+
+	compressionCodec            = "deflate"
+	defaultCompressionThreshold = 4096
+
+	// maxDecompressedSize bounds what one field may inflate to, so a corrupt or hostile
+	// message cannot exhaust memory; a message that large would not fit a spool segment
+	maxDecompressedSize = spoolSegmentSize
+)
+
+// compressionLevels maps the compression input to a deflate level: fast favours latency,
+// best favours ratio
+var compressionLevels = map[string]int{
+	"fast": flate.BestSpeed,
+	"best": flate.BestCompression,
+}
+
+var (
+	flateWritersMu sync.Mutex
+	flateWriters   = make(map[int]*sync.Pool)
+)
+
+func flateWriterPool(level int) *sync.Pool {
+	flateWritersMu.Lock()
+	defer flateWritersMu.Unlock()
+
+	pool, ok := flateWriters[level]
+	if !ok {
+		pool = &sync.Pool{New: func() interface{} {
+			w, _ := flate.NewWriter(nil, level)
+			return w
+		}}
+		flateWriters[level] = pool
+	}
+	return pool
+}
+
+func deflate(data []byte, level int) ([]byte, error) {
+	pool := flateWriterPool(level)
+	w := pool.Get().(*flate.Writer)
+	defer pool.Put(w)
+
+	var buf bytes.Buffer
+	w.Reset(&buf)
+	if _, err := w.Write(data); err != nil {
+		return nil, err
+	}
+	if err := w.Close(); err != nil {
+		return nil, err
+	}
+	return buf.Bytes(), nil
+}
+
+// compressFields replaces the opaque and string fields of at least threshold bytes with
+// their compressed form when that is smaller, and records what it did in the header fields
+func compressFields(fields map[string]interface{}, mode string, threshold int) error {
+	level, ok := compressionLevels[mode]
+	if !ok {
+		return fmt.Errorf("unknown compression [%s]", mode)
+	}
+	if threshold <= 0 {
+		threshold = defaultCompressionThreshold
+	}
+
+	var opaque, text []string
+	for name, value := range fields {
+		var data []byte
+		switch v := value.(type) {
+		case []byte:
+			data = v
+		case string:
+			data = []byte(v)
+		default:
+			continue
+		}
+		if len(data) < threshold {
+			continue
+		}
+		compressed, err := deflate(data, level)
+		if err != nil {
+			return err
+		}
+		if len(compressed) >= len(data) {
+			continue
+		}
+		fields[name] = compressed
+		if _, ok := value.(string); ok {
+			text = append(text, name)
+		} else {
+			opaque = append(opaque, name)
+		}
+	}
+
+	if opaque == nil && text == nil {
+		return nil
+	}
+	fields[codecField] = compressionCodec
+	if opaque != nil {
+		fields[compressedField] = opaque
+	}
+	if text != nil {
+		fields[compressedTextField] = text
+	}
+	return nil
+}
+
+// inflate decompresses data, failing when it holds more than limit bytes
+func inflate(data []byte, limit int64) ([]byte, error) {
+	out, err := ioutil.ReadAll(io.LimitReader(flate.NewReader(bytes.NewReader(data)), limit+1))
+	if err != nil {
+		return nil, err
+	}
+	if int64(len(out)) > limit {
+		return nil, fmt.Errorf("inflates to more than %d bytes", limit)
+	}
+	return out, nil
+}
+
+// decompressFields restores the fields of a message compressed by compressFields and
+// removes its header fields; other messages are left alone
+func decompressFields(fields map[string]interface{}) error {
+	codec, ok := fields[codecField]
+	if !ok {
+		return nil
+	}
+	if codec != compressionCodec {
+		return fmt.Errorf("unknown compression codec [%v]", codec)
+	}
+
+	opaque, _ := fields[compressedField].([]string)
+	text, _ := fields[compressedTextField].([]string)
+	for i, names := range [][]string{opaque, text} {
+		for _, name := range names {
+			compressed, ok := fields[name].([]byte)
+			if !ok {
+				return fmt.Errorf("compressed field [%s] is not opaque", name)
+			}
+			data, err := inflate(compressed, maxDecompressedSize)
+			if err != nil {
+				return fmt.Errorf("compressed field [%s]: %v", name, err)
+			}
+			if i == 0 {
+				fields[name] = data
+			} else {
+				fields[name] = string(data)
+			}
+		}
+	}
+
+	delete(fields, codecField)
+	delete(fields, compressedField)
+	delete(fields, compressedTextField)
+	return nil
+}
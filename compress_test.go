@@ -0,0 +1,56 @@
+package FTLogo
+
+import (
+	"bytes"
+	"strings"
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func TestCompressFields(t *testing.T) {
+	doc := strings.Repeat(`{"order":12345,"status":"filled"}`, 200)
+	blob := bytes.Repeat([]byte{1, 2, 3, 4}, 2000)
+	fields := map[string]interface{}{"type": "hello", "message": doc, "blob": blob, "small": "x"}
+
+	for _, mode := range []string{"fast", "best"} {
+		sent := map[string]interface{}{}
+		for k, v := range fields {
+			sent[k] = v
+		}
+		assert.Nil(t, compressFields(sent, mode, 1024))
+		assert.Equal(t, compressionCodec, sent[codecField])
+		assert.True(t, len(sent["message"].([]byte)) < len(doc)/5)
+
+		// what a subscriber decodes is restored to the original fields
+		data, err := encodeMessage(nil, sent)
+		assert.Nil(t, err)
+		received, err := decodeMessage(data)
+		assert.Nil(t, err)
+		assert.Nil(t, decompressFields(received))
+		assert.Equal(t, fields, received)
+	}
+
+	assert.NotNil(t, compressFields(map[string]interface{}{}, "lz4", 0))
+}
+
+func TestCompressFieldsBelowThreshold(t *testing.T) {
+	fields := map[string]interface{}{"message": strings.Repeat("a", 100)}
+	assert.Nil(t, compressFields(fields, "fast", 0))
+	assert.Len(t, fields, 1)
+	assert.Nil(t, decompressFields(fields))
+}
+
+func TestInflateLimit(t *testing.T) {
+	data := bytes.Repeat([]byte("a"), 2000)
+	compressed, err := deflate(data, compressionLevels["best"])
+	assert.Nil(t, err)
+
+	inflated, err := inflate(compressed, 2000)
+	assert.Nil(t, err)
+	assert.Equal(t, data, inflated)
+
+	// a field inflating past the limit fails instead of growing without bound
+	_, err = inflate(compressed, 1999)
+	assert.NotNil(t, err)
+}
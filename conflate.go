@@ -0,0 +1,131 @@
+package FTLogo
+
+import (
+	"fmt"
+	"strconv"
+	"sync"
+	"time"
+)
+
+// conflated is the latest message of a key, with the send of the flow that queued it
+type conflated struct {
+	fields map[string]interface{}
+	send   sendFunc
+}
+
+// conflater keeps only the latest message of each key and sends them every interval,
+// in the order their keys first appeared since the last flush
+type conflater struct {
+	conn     *realmConn
+	endpoint string
+	interval time.Duration
+	stop     chan struct{}
+
+	mu      sync.Mutex
+	latest  map[string]conflated
+	order   []string
+	retired bool
+
+	// received and sent count messages for the conflation ratio in the debug log
+	received int
+	sent     int
+}
+
+var (
+	conflatersMu sync.Mutex
+	conflaters   = make(map[string]*conflater)
+)
+
+// getConflater returns the conflater of an endpoint flushing every interval, starting its
+// flush loop on first use
+func getConflater(conn *realmConn, endpoint, group string, interval time.Duration) *conflater {
+	conflatersMu.Lock()
+	defer conflatersMu.Unlock()
+
+	key := conn.url + "|" + endpoint + "|" + group + "|" + strconv.FormatInt(int64(interval), 10)
+	if c, ok := conflaters[key]; ok {
+		return c
+	}
+	c := &conflater{conn: conn, endpoint: endpoint, interval: interval, stop: make(chan struct{}), latest: make(map[string]conflated)}
+	go c.run()
+	conflaters[key] = c
+	return c
+}
+
+// retireConflaters flushes the conflaters of conn one last time and stops them
+func retireConflaters(conn *realmConn) {
+	conflatersMu.Lock()
+	defer conflatersMu.Unlock()
+
+	for key, c := range conflaters {
+		if c.conn == conn {
+			delete(conflaters, key)
+			close(c.stop)
+		}
+	}
+}
+
+// add queues fields as the latest message of key, to be sent with send, reporting whether
+// it replaced a pending one
+func (c *conflater) add(key string, fields map[string]interface{}, send sendFunc) (bool, error) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+
+	if c.retired {
+		return false, fmt.Errorf("conflater of endpoint [%s] was retired with its realm connection", c.endpoint)
+	}
+	c.received++
+	_, replaced := c.latest[key]
+	if !replaced {
+		c.order = append(c.order, key)
+	}
+	c.latest[key] = conflated{fields: fields, send: send}
+	return replaced, nil
+}
+
+// take removes and returns the pending messages in key order
+func (c *conflater) take() []conflated {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+
+	msgs := make([]conflated, len(c.order))
+	for i, key := range c.order {
+		msgs[i] = c.latest[key]
+	}
+	c.sent += len(msgs)
+	c.latest = make(map[string]conflated, len(c.order))
+	c.order = c.order[:0]
+	return msgs
+}
+
+func (c *conflater) run() {
+	ticker := time.NewTicker(c.interval)
+	defer ticker.Stop()
+
+	for {
+		select {
+		case <-ticker.C:
+			c.flush()
+		case <-c.stop:
+			c.mu.Lock()
+			c.retired = true
+			c.mu.Unlock()
+			c.flush()
+			return
+		}
+	}
+}
+
+// flush sends the pending messages, each through the send it was queued with
+func (c *conflater) flush() {
+	for _, m := range c.take() {
+		if _, err := m.send(c.endpoint, m.fields); err != nil {
+			log.Errorf("Unable to send conflated message to endpoint [%s]: %v", c.endpoint, err)
+		}
+	}
+	if log.DebugEnabled() {
+		c.mu.Lock()
+		log.Debugf("Endpoint [%s] conflated %d messages into %d", c.endpoint, c.received, c.sent)
+		c.mu.Unlock()
+	}
+}
@@ -0,0 +1,40 @@
+package FTLogo
+
+import (
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func TestConflaterKeepsLatest(t *testing.T) {
+	c := &conflater{latest: make(map[string]conflated)}
+	var sentBy string
+	sendAs := func(name string) sendFunc {
+		return func(endpoint string, fields map[string]interface{}) (bool, error) {
+			sentBy = name
+			return true, nil
+		}
+	}
+
+	replaced, err := c.add("IBM", map[string]interface{}{"price": 1.0}, sendAs("first"))
+	assert.Nil(t, err)
+	assert.False(t, replaced)
+	replaced, err = c.add("MSFT", map[string]interface{}{"price": 2.0}, sendAs("first"))
+	assert.Nil(t, err)
+	assert.False(t, replaced)
+	replaced, err = c.add("IBM", map[string]interface{}{"price": 3.0}, sendAs("second"))
+	assert.Nil(t, err)
+	assert.True(t, replaced)
+
+	msgs := c.take()
+	assert.Len(t, msgs, 2)
+	assert.Equal(t, 3.0, msgs[0].fields["price"])
+	assert.Equal(t, 2.0, msgs[1].fields["price"])
+
+	// the latest message goes out with the send of the flow that queued it
+	msgs[0].send("ep", msgs[0].fields)
+	assert.Equal(t, "second", sentBy)
+	assert.Len(t, c.take(), 0)
+	assert.Equal(t, 3, c.received)
+	assert.Equal(t, 2, c.sent)
+}
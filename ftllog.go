@@ -0,0 +1,259 @@
+package FTLogo
+
+/*
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tib/ftl.h"
+
+#define LOG_SLOTS   1024
+#define LOG_LINE    512
+
+// logSlot holds one statement; seq tells producers and the consumer whose turn the slot is
+typedef struct logSlot
+{
+    atomic_uint_fast64_t    seq;
+    tibint64_t              sec;
+    tibint64_t              nsec;
+    int                     len;
+    char                    text[LOG_LINE];
+} logSlot;
+
+static logSlot              logRing[LOG_SLOTS];
+static atomic_uint_fast64_t logHead;
+static uint64_t             logTail;
+static atomic_uint_fast64_t logDropped;
+
+// onLog runs on FTL threads: it claims a slot without locking and never waits, dropping
+// the statement when the ring is full
+static void onLog(tibDateTime timestamp, const char *statement, void *closure)
+{
+    uint64_t    pos = atomic_load_explicit(&logHead, memory_order_relaxed);
+    logSlot     *slot;
+    size_t      n;
+
+    for (;;)
+    {
+        slot = &logRing[pos & (LOG_SLOTS-1)];
+        int64_t diff = (int64_t)atomic_load_explicit(&slot->seq, memory_order_acquire) - (int64_t)pos;
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&logHead, &pos, pos+1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            atomic_fetch_add_explicit(&logDropped, 1, memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&logHead, memory_order_relaxed);
+        }
+    }
+
+    n = strlen(statement);
+    if (n > LOG_LINE)
+        n = LOG_LINE;
+    memcpy(slot->text, statement, n);
+    slot->len = (int)n;
+    slot->sec = timestamp.sec;
+    slot->nsec = timestamp.nsec;
+    atomic_store_explicit(&slot->seq, pos+1, memory_order_release);
+}
+
+static void installLogCallback(tibEx ex)
+{
+    int i;
+
+    for (i = 0; i < LOG_SLOTS; i++)
+        atomic_init(&logRing[i].seq, i);
+    tib_SetLogCallback(ex, onLog, NULL, NULL);
+}
+
+// drainLog moves statements into buf as sec, nsec and length prefixed text and returns the
+// bytes used; only the draining goroutine calls it
+static int drainLog(char *buf, int cap)
+{
+    int used = 0;
+
+    for (;;)
+    {
+        logSlot *slot = &logRing[logTail & (LOG_SLOTS-1)];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != logTail+1)
+            break;
+        if (used + 20 + slot->len > cap)
+            break;
+
+        memcpy(buf+used, &slot->sec, 8);
+        memcpy(buf+used+8, &slot->nsec, 8);
+        memcpy(buf+used+16, &slot->len, 4);
+        memcpy(buf+used+20, slot->text, slot->len);
+        used += 20 + slot->len;
+
+        atomic_store_explicit(&slot->seq, logTail+LOG_SLOTS, memory_order_release);
+        logTail++;
+    }
+    return used;
+}
+
+static uint64_t takeLogDropped(void)
+{
+    return atomic_exchange_explicit(&logDropped, 0, memory_order_relaxed);
+}
+*/
+import "C"
+
+import (
+	"encoding/binary"
+	"os"
+	"strconv"
+	"strings"
+	"time"
+	"unsafe"
+
+	"github.com/TIBCOSoftware/flogo-lib/logger"
+)
+
+const (
+	// ftlLogLevelEnv sets the FTL library log level, one of the TIB_LOG_LEVEL values
+	ftlLogLevelEnv = "FTLOGO_FTL_LOG_LEVEL"
+
+	// ftlLogRateEnv caps the FTL statements forwarded per second, 200 by default
+	ftlLogRateEnv = "FTLOGO_FTL_LOG_RATE"
+
+	ftlLogPoll = 20 * time.Millisecond
+)
+
+// ftlLog receives the statements of the FTL library
+var ftlLog = logger.GetLogger("ftl")
+
+// startFTLLog routes FTL library logging into a ring buffer that a goroutine drains into
+// the Flogo logger, so FTL threads never block on log output
+func startFTLLog(ex C.tibEx) {
+	if level := os.Getenv(ftlLogLevelEnv); level != "" {
+		clevel := C.CString(level)
+		C.tib_SetLogLevel(ex, clevel)
+		C.free(unsafe.Pointer(clevel))
+	}
+	C.installLogCallback(ex)
+
+	rate, err := strconv.Atoi(os.Getenv(ftlLogRateEnv))
+	if err != nil || rate <= 0 {
+		rate = 200
+	}
+	go drainFTLLog(&logLimiter{rate: rate})
+}
+
+func drainFTLLog(limiter *logLimiter) {
+	buf := make([]byte, 64<<10)
+	for {
+		n := int(C.drainLog((*C.char)(unsafe.Pointer(&buf[0])), C.int(len(buf))))
+		for _, e := range parseFTLLog(buf[:n]) {
+			if limiter.allow(e.at) {
+				forwardFTLLog(e.text)
+			}
+		}
+
+		now := time.Now()
+		if dropped := uint64(C.takeLogDropped()); dropped > 0 {
+			ftlLog.Warnf("FTL log buffer full, %d statements dropped", dropped)
+		}
+		if suppressed := limiter.flush(now); suppressed > 0 {
+			ftlLog.Warnf("FTL log rate above %d/s, %d statements suppressed", limiter.rate, suppressed)
+		}
+		if n == 0 {
+			time.Sleep(ftlLogPoll)
+		}
+	}
+}
+
+// ftlLogEntry is one statement drained from the ring
+type ftlLogEntry struct {
+	at   time.Time
+	text string
+}
+
+func parseFTLLog(b []byte) []ftlLogEntry {
+	var entries []ftlLogEntry
+	for len(b) >= 20 {
+		n := int(binary.LittleEndian.Uint32(b[16:]))
+		if 20+n > len(b) {
+			break
+		}
+		entries = append(entries, ftlLogEntry{
+			at:   time.Unix(int64(binary.LittleEndian.Uint64(b)), int64(binary.LittleEndian.Uint64(b[8:]))),
+			text: strings.TrimRight(string(b[20:20+n]), "\n"),
+		})
+		b = b[20+n:]
+	}
+	return entries
+}
+
+// forwardFTLLog logs a statement at the Flogo level matching the FTL level it names
+func forwardFTLLog(text string) {
+	switch ftlLogLevel(text) {
+	case "severe":
+		ftlLog.Error(text)
+	case "warn":
+		ftlLog.Warn(text)
+	case "verbose", "debug":
+		ftlLog.Debug(text)
+	default:
+		ftlLog.Info(text)
+	}
+}
+
+// ftlLogLevel reads the level field of an FTL statement: the upper case level word right
+// after the timestamp, or after the one source field that may precede it. Words of the
+// statement text are never taken for the level; "info" when the statement names none.
+func ftlLogLevel(text string) string {
+	fields := strings.Fields(text)
+	start := 0
+	for start < len(fields) && start < 2 && strings.Trim(fields[start], "0123456789-:.T") == "" {
+		start++
+	}
+	for i := start; i < len(fields) && i < start+2; i++ {
+		switch level := strings.Trim(fields[i], "[]:"); level {
+		case "SEVERE", "ERROR":
+			return "severe"
+		case "WARN", "WARNING":
+			return "warn"
+		case "INFO", "VERBOSE", "DEBUG":
+			return strings.ToLower(level)
+		}
+	}
+	return "info"
+}
+
+// logLimiter forwards at most rate statements per second of their timestamps and counts
+// the rest; it is only used by the draining goroutine
+type logLimiter struct {
+	rate       int
+	window     int64
+	count      int
+	suppressed int
+}
+
+func (l *logLimiter) allow(at time.Time) bool {
+	if window := at.Unix(); window != l.window {
+		l.window, l.count = window, 0
+	}
+	if l.count >= l.rate {
+		l.suppressed++
+		return false
+	}
+	l.count++
+	return true
+}
+
+// flush returns and resets the number of statements suppressed once per second
+func (l *logLimiter) flush(now time.Time) int {
+	if l.suppressed == 0 || now.Unix() == l.window {
+		return 0
+	}
+	n := l.suppressed
+	l.suppressed = 0
+	return n
+}
@@ -0,0 +1,52 @@
+package FTLogo
+
+import (
+	"encoding/binary"
+	"testing"
+	"time"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func TestParseFTLLog(t *testing.T) {
+	var b []byte
+	for _, text := range []string{"first\n", "second"} {
+		entry := make([]byte, 20)
+		binary.LittleEndian.PutUint64(entry, 1500000000)
+		binary.LittleEndian.PutUint64(entry[8:], 5)
+		binary.LittleEndian.PutUint32(entry[16:], uint32(len(text)))
+		b = append(append(b, entry...), text...)
+	}
+
+	entries := parseFTLLog(b)
+	assert.Len(t, entries, 2)
+	assert.Equal(t, "first", entries[0].text)
+	assert.Equal(t, "second", entries[1].text)
+	assert.True(t, time.Unix(1500000000, 5).Equal(entries[1].at))
+}
+
+func TestFTLLogLevel(t *testing.T) {
+	assert.Equal(t, "severe", ftlLogLevel("2017-08-01 10:00:00.000 host SEVERE: realm lost"))
+	assert.Equal(t, "warn", ftlLogLevel("[WARN] slow consumer"))
+	assert.Equal(t, "debug", ftlLogLevel("2017-08-01 10:00:00.000 DEBUG: tport ready"))
+	assert.Equal(t, "info", ftlLogLevel("connected"))
+
+	// level words in the statement text are not its level
+	assert.Equal(t, "info", ftlLogLevel("2017-08-01 10:00:00.000 host INFO: retrying after error"))
+	assert.Equal(t, "info", ftlLogLevel("connected, previous ERROR cleared"))
+	assert.Equal(t, "info", ftlLogLevel("2017-08-01 10:00:00.000 host tport: debug enabled"))
+}
+
+func TestLogLimiter(t *testing.T) {
+	l := &logLimiter{rate: 2}
+	at := time.Unix(1500000000, 0)
+
+	assert.True(t, l.allow(at))
+	assert.True(t, l.allow(at))
+	assert.False(t, l.allow(at))
+	assert.Equal(t, 0, l.flush(at))
+	assert.Equal(t, 1, l.flush(at.Add(time.Second)))
+
+	// a new second starts a new allowance
+	assert.True(t, l.allow(at.Add(time.Second)))
+}
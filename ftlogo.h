@@ -0,0 +1,38 @@
+/*
+ * C helpers shared by the cgo preambles of the FTLogo activity.
+ * The definitions live in the preamble of the Go file named next to each group.
+ */
+#ifndef _INCLUDED_ftlogo_h
+#define _INCLUDED_ftlogo_h
+
+#include <stdint.h>
+#include "tib/ftl.h"
+
+/* Growable view over a caller supplied buffer: writes past cap are counted
+ * but not stored, so len reports the size the caller needs to retry with. */
+typedef struct ftlogoBuf
+{
+    char    *data;
+    int     cap;
+    int     len;
+} ftlogoBuf;
+
+/* Cursor over an encoding produced on the Go side; pos moves past len on malformed input. */
+typedef struct ftlogoReader
+{
+    const char  *data;
+    int         len;
+    int         pos;
+} ftlogoReader;
+
+/* message.go */
+void ftlogoBuf_Put(ftlogoBuf *b, const void *p, int n);
+void ftlogoBuf_PutU32(ftlogoBuf *b, uint32_t v);
+void ftlogoBuf_PutString(ftlogoBuf *b, const char *s, int n);
+void ftlogoMessage_Encode(tibEx ex, tibMessage msg, ftlogoBuf *b);
+tibMessage ftlogoMessage_Decode(tibEx ex, tibRealm realm, ftlogoReader *r, int *bad);
+
+/* senders.go */
+int ftlogoSendEncoded(tibEx ex, tibRealm realm, tibPublisher pub, const char *data, int len);
+
+#endif /* _INCLUDED_ftlogo_h */
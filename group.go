@@ -0,0 +1,143 @@
+package FTLogo
+
+/*
+#cgo LDFLAGS: -ltibgroup
+
+#include <stdlib.h>
+#include "tib/ftl.h"
+#include "tibgroup/group.h"
+
+// Joins a group with a member descriptor so the member shows up in GROUP_STATUS advisories;
+// a positive activationInterval overrides the group's default
+static tibGroup joinGroup(tibEx ex, tibRealm realm, const char *name, const char *member,
+                          double activationInterval)
+{
+    tibProperties   props;
+    tibMessage      descriptor;
+    tibGroup        group;
+
+    props = tibProperties_Create(ex);
+    descriptor = tibMessage_Create(ex, realm, NULL);
+    tibMessage_SetString(ex, descriptor, "member", member);
+    tibProperties_SetMessage(ex, props, TIB_GROUP_PROPERTY_MESSAGE_MEMBER_DESCRIPTOR, descriptor);
+    if (activationInterval > 0)
+        tibProperties_SetDouble(ex, props, TIB_GROUP_PROPERTY_DOUBLE_ACTIVATION_INTERVAL, activationInterval);
+    group = tibGroup_Join(ex, realm, name, props);
+    tibMessage_Destroy(ex, descriptor);
+    tibProperties_Destroy(ex, props);
+    return group;
+}
+*/
+import "C"
+
+import (
+	"encoding/json"
+	"fmt"
+	"hash/fnv"
+	"os"
+	"sync/atomic"
+	"unsafe"
+)
+
+// groupMember is this process's membership of a group. Members own the key-hash partitions
+// matching their ordinal among the current members; ordinals stay contiguous as members come and go.
+type groupMember struct {
+	name    string
+	group   C.tibGroup
+	ordinal int64
+	members int64
+	subs    []*subscription
+
+	// onOrdinal, when set, runs on the dispatch thread after every ordinal update
+	onOrdinal func(ordinal int64)
+}
+
+// joinGroup subscribes to the group advisories on queue and then joins the group
+func joinGroup(queue *eventQueue, name string, activationInterval float64, onOrdinal func(ordinal int64)) (*groupMember, error) {
+	m := &groupMember{name: name, onOrdinal: onOrdinal}
+
+	for _, advisory := range []string{"ORDINAL_UPDATE", "GROUP_STATUS"} {
+		matcher, _ := json.Marshal(map[string]string{"name": advisory, "group": name})
+		s, err := queue.subscribe(subscriberConfig{endpoint: advisoryEndpoint, matcher: string(matcher)}, m.onAdvisories)
+		if err != nil {
+			m.leave()
+			return nil, err
+		}
+		m.subs = append(m.subs, s)
+	}
+
+	ex := C.tibEx_Create()
+	defer C.tibEx_Destroy(ex)
+
+	host, _ := os.Hostname()
+	cname := C.CString(name)
+	defer C.free(unsafe.Pointer(cname))
+	cmember := C.CString(fmt.Sprintf("%s-%d", host, os.Getpid()))
+	defer C.free(unsafe.Pointer(cmember))
+
+	m.group = C.joinGroup(ex, queue.conn.realm, cname, cmember, C.double(activationInterval))
+	if err := exError(ex); err != nil {
+		m.leave()
+		return nil, err
+	}
+	return m, nil
+}
+
+func (m *groupMember) onAdvisories(msgs []*inboundMessage) {
+	for _, msg := range msgs {
+		switch msg.fields["name"] {
+		case "ORDINAL_UPDATE":
+			ordinal, _ := msg.fields["ordinal"].(int64)
+			atomic.StoreInt64(&m.ordinal, ordinal)
+			log.Infof("Group [%s] ordinal is now %d", m.name, ordinal)
+			if m.onOrdinal != nil {
+				m.onOrdinal(ordinal)
+			}
+		case "GROUP_STATUS":
+			statuses, _ := msg.fields["group_member_status_list"].([]map[string]interface{})
+			var joined int64
+			for _, status := range statuses {
+				if event, ok := status["group_member_event"].(int64); ok && event == 0 {
+					joined++
+				}
+			}
+			atomic.StoreInt64(&m.members, joined)
+			log.Infof("Group [%s] has %d members", m.name, joined)
+		}
+	}
+}
+
+// owns reports whether key falls in this member's partition. A disconnected member
+// (ordinal -1) or one that has not been assigned an ordinal yet owns nothing.
+func (m *groupMember) owns(key string) bool {
+	ordinal := atomic.LoadInt64(&m.ordinal)
+	if ordinal <= 0 {
+		return false
+	}
+	members := atomic.LoadInt64(&m.members)
+	if members < ordinal {
+		// the status may lag the ordinal; ordinals are contiguous so there are at least this many
+		members = ordinal
+	}
+	return partitionOf(key, members) == ordinal
+}
+
+// partitionOf maps a key onto an ordinal between 1 and members
+func partitionOf(key string, members int64) int64 {
+	h := fnv.New32a()
+	h.Write([]byte(key))
+	return int64(h.Sum32()%uint32(members)) + 1
+}
+
+// leave drops the advisory subscriptions and leaves the group
+func (m *groupMember) leave() {
+	for _, s := range m.subs {
+		s.close()
+	}
+	if m.group != nil {
+		ex := C.tibEx_Create()
+		C.tibGroup_Leave(ex, m.group)
+		C.tibEx_Destroy(ex)
+		m.group = nil
+	}
+}
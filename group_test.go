@@ -0,0 +1,30 @@
+package FTLogo
+
+import (
+	"fmt"
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func TestPartitionOf(t *testing.T) {
+	counts := make(map[int64]int)
+	for i := 0; i < 3000; i++ {
+		p := partitionOf(fmt.Sprintf("key-%d", i), 3)
+		assert.True(t, p >= 1 && p <= 3)
+		counts[p]++
+	}
+	assert.Len(t, counts, 3)
+	assert.Equal(t, partitionOf("key-1", 3), partitionOf("key-1", 3))
+}
+
+func TestGroupMemberOwns(t *testing.T) {
+	members := []*groupMember{{ordinal: 1, members: 2}, {ordinal: 2, members: 2}}
+	for i := 0; i < 100; i++ {
+		key := fmt.Sprintf("key-%d", i)
+		assert.True(t, members[0].owns(key) != members[1].owns(key))
+	}
+
+	// a disconnected member owns nothing
+	assert.False(t, (&groupMember{ordinal: -1, members: 2}).owns("key-1"))
+}
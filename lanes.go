@@ -0,0 +1,251 @@
+package FTLogo
+
+/*
+#include <stdlib.h>
+#include "ftlogo.h"
+*/
+import "C"
+
+import (
+	"fmt"
+	"runtime"
+	"sync"
+	"unsafe"
+)
+
+// priority lanes in scheduling order, and their shares under weighted scheduling
+var (
+	laneNames   = []string{"control", "normal", "bulk"}
+	laneWeights = []int{8, 4, 1}
+)
+
+const laneQueueSize = 1024
+
+// laneMessage is an encoded message waiting in a lane
+type laneMessage struct {
+	data []byte
+	done chan error
+}
+
+// lane sends the messages of one priority through a publisher of its own, from its own
+// locked thread
+type lane struct {
+	set   *laneSet
+	index int
+	pub   C.tibPublisher
+	queue chan laneMessage
+}
+
+// laneSet holds the lanes of one endpoint. Lanes share a single turn to send: when it is
+// released the gate hands it to the highest waiting lane under strict scheduling, or by
+// smooth weighted round robin among the waiting lanes otherwise. A control message thus
+// waits for at most the one bulk message being sent, never for the bulk queue. Rate limits
+// are taken inside the turn, so bulk messages waiting for tokens do not hold it either.
+type laneSet struct {
+	conn     *realmConn
+	endpoint string
+	lanes    []*lane
+	gate     laneGate
+
+	// mu keeps retire from closing the lane queues while a flow is sending to them
+	mu      sync.RWMutex
+	retired bool
+}
+
+var (
+	laneSetsMu sync.Mutex
+	laneSets   = make(map[string]*laneSet)
+)
+
+// laneIndex returns the lane of a priority name
+func laneIndex(priority string) (int, error) {
+	for i, name := range laneNames {
+		if name == priority {
+			return i, nil
+		}
+	}
+	return 0, fmt.Errorf("unknown priority [%s]", priority)
+}
+
+func getLaneSet(conn *realmConn, endpoint string, strict bool) (*laneSet, error) {
+	laneSetsMu.Lock()
+	defer laneSetsMu.Unlock()
+
+	key := conn.url + "|" + endpoint + "|weighted"
+	if strict {
+		key = conn.url + "|" + endpoint + "|strict"
+	}
+	if s, ok := laneSets[key]; ok {
+		return s, nil
+	}
+	if err := conn.checkLive(); err != nil {
+		return nil, err
+	}
+
+	ex := C.tibEx_Create()
+	defer C.tibEx_Destroy(ex)
+
+	cendpoint := cStringOrNil(endpoint)
+	defer C.free(unsafe.Pointer(cendpoint))
+
+	s := &laneSet{conn: conn, endpoint: endpoint}
+	s.gate.init(len(laneNames), strict)
+	for i := range laneNames {
+		pub := C.tibPublisher_Create(ex, conn.realm, cendpoint, nil)
+		if err := exError(ex); err != nil {
+			for _, l := range s.lanes {
+				C.tibPublisher_Close(ex, l.pub)
+			}
+			return nil, err
+		}
+		s.lanes = append(s.lanes, &lane{set: s, index: i, pub: pub, queue: make(chan laneMessage, laneQueueSize)})
+	}
+	for _, l := range s.lanes {
+		go l.run()
+	}
+
+	laneSets[key] = s
+	return s, nil
+}
+
+// send queues fields on the lane of priority, once the rate limits allow it, and waits
+// until they are sent
+func (s *laneSet) send(priority int, fields map[string]interface{}) error {
+	data, err := encodeMessage(nil, fields)
+	if err != nil {
+		return err
+	}
+	done := make(chan error, 1)
+	s.mu.RLock()
+	if s.retired {
+		s.mu.RUnlock()
+		return fmt.Errorf("lanes of endpoint [%s] were retired with their realm connection", s.endpoint)
+	}
+	s.lanes[priority].queue <- laneMessage{data: data, done: done}
+	s.mu.RUnlock()
+	return <-done
+}
+
+// retireLaneSets stops the lanes of conn once they have sent what is queued
+func retireLaneSets(conn *realmConn) {
+	laneSetsMu.Lock()
+	var retired []*laneSet
+	for key, s := range laneSets {
+		if s.conn == conn {
+			delete(laneSets, key)
+			retired = append(retired, s)
+		}
+	}
+	laneSetsMu.Unlock()
+
+	for _, s := range retired {
+		s.mu.Lock()
+		s.retired = true
+		for _, l := range s.lanes {
+			close(l.queue)
+		}
+		s.mu.Unlock()
+	}
+}
+
+// takeTurn waits for the turn of the lane, then for the rate limits of the endpoint; a lane
+// queued behind others does not take tokens ahead of them
+func (l *lane) takeTurn() {
+	l.set.gate.acquire(l.index)
+	takeRate(l.set.conn.url, l.set.endpoint, 1)
+}
+
+func (l *lane) run() {
+	runtime.LockOSThread()
+	defer runtime.UnlockOSThread()
+
+	ex := C.tibEx_Create()
+	defer C.tibEx_Destroy(ex)
+
+	for m := range l.queue {
+		cdata := C.CBytes(m.data)
+
+		l.takeTurn()
+		rc := C.ftlogoSendEncoded(ex, l.set.conn.realm, l.pub, (*C.char)(cdata), C.int(len(m.data)))
+		l.set.gate.release()
+
+		C.free(cdata)
+		if rc < 0 {
+			m.done <- fmt.Errorf("malformed message encoding")
+		} else {
+			m.done <- exError(ex)
+		}
+		C.tibEx_Clear(ex)
+	}
+	C.tibPublisher_Close(ex, l.pub)
+}
+
+// laneGate grants the turn to send to one lane at a time. Each lane has a single thread,
+// so at most one waiter per lane.
+type laneGate struct {
+	mu      sync.Mutex
+	strict  bool
+	busy    bool
+	waiting []bool
+	wake    []chan struct{}
+	current []int
+}
+
+func (g *laneGate) init(n int, strict bool) {
+	g.strict = strict
+	g.waiting = make([]bool, n)
+	g.current = make([]int, n)
+	g.wake = make([]chan struct{}, n)
+	for i := range g.wake {
+		g.wake[i] = make(chan struct{}, 1)
+	}
+}
+
+// acquire waits for the turn of lane i
+func (g *laneGate) acquire(i int) {
+	g.mu.Lock()
+	if !g.busy {
+		g.busy = true
+		g.mu.Unlock()
+		return
+	}
+	g.waiting[i] = true
+	g.mu.Unlock()
+	<-g.wake[i]
+}
+
+// release hands the turn to the next waiting lane
+func (g *laneGate) release() {
+	g.mu.Lock()
+	defer g.mu.Unlock()
+
+	next := g.next()
+	if next < 0 {
+		g.busy = false
+		return
+	}
+	g.waiting[next] = false
+	g.wake[next] <- struct{}{}
+}
+
+// next picks the waiting lane to run next, -1 when none waits; callers hold mu
+func (g *laneGate) next() int {
+	best, total := -1, 0
+	for i, waiting := range g.waiting {
+		if !waiting {
+			continue
+		}
+		if g.strict {
+			return i
+		}
+		g.current[i] += laneWeights[i]
+		total += laneWeights[i]
+		if best < 0 || g.current[i] > g.current[best] {
+			best = i
+		}
+	}
+	if best >= 0 {
+		g.current[best] -= total
+	}
+	return best
+}
@@ -0,0 +1,87 @@
+package FTLogo
+
+import (
+	"runtime"
+	"sync/atomic"
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func TestLaneIndex(t *testing.T) {
+	i, err := laneIndex("bulk")
+	assert.Nil(t, err)
+	assert.Equal(t, 2, i)
+
+	_, err = laneIndex("urgent")
+	assert.NotNil(t, err)
+}
+
+func TestLaneGateStrict(t *testing.T) {
+	var g laneGate
+	g.init(3, true)
+
+	g.waiting[2], g.waiting[0] = true, true
+	assert.Equal(t, 0, g.next())
+	g.waiting[0] = false
+	assert.Equal(t, 2, g.next())
+	g.waiting[2] = false
+	assert.Equal(t, -1, g.next())
+}
+
+func TestLaneGateWeighted(t *testing.T) {
+	var g laneGate
+	g.init(3, false)
+
+	// with every lane always waiting, turns follow the 8:4:1 weights
+	turns := make([]int, 3)
+	for i := 0; i < 13*10; i++ {
+		g.waiting[0], g.waiting[1], g.waiting[2] = true, true, true
+		turns[g.next()]++
+	}
+	assert.Equal(t, []int{80, 40, 10}, turns)
+}
+
+func TestLaneGateHandOff(t *testing.T) {
+	var g laneGate
+	g.init(3, true)
+
+	g.acquire(2)
+	granted := make(chan struct{})
+	go func() {
+		g.acquire(0)
+		close(granted)
+	}()
+	for {
+		g.mu.Lock()
+		waiting := g.waiting[0]
+		g.mu.Unlock()
+		if waiting {
+			break
+		}
+		runtime.Gosched()
+	}
+	g.release()
+	<-granted
+	g.release()
+	assert.False(t, g.busy)
+}
+
+func TestLaneTurnTakesRate(t *testing.T) {
+	b := rateLimiter(endpointLimiterKey("lane-rate", "ep"), 1000000, 1000000)
+	s := &laneSet{conn: newRealmConn("lane-rate"), endpoint: "ep", lanes: []*lane{{queue: make(chan laneMessage, 1)}}}
+	s.gate.init(1, true)
+	l := &lane{set: s, index: 0, queue: s.lanes[0].queue}
+	go func() {
+		m := <-s.lanes[0].queue
+		m.done <- nil
+	}()
+
+	// queueing takes no tokens; the lane takes them once it holds the turn
+	assert.Nil(t, s.send(0, map[string]interface{}{"n": int64(1)}))
+	assert.Equal(t, int64(0), atomic.LoadInt64(&b.tat))
+	l.takeTurn()
+	assert.True(t, s.gate.busy)
+	assert.True(t, atomic.LoadInt64(&b.tat) > 0)
+	s.gate.release()
+}
@@ -0,0 +1,235 @@
+package FTLogo
+
+import (
+	"encoding/json"
+	"fmt"
+	"math"
+	"math/bits"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+// latencySubBuckets is the resolution of each power of two in a latencyHistogram, which
+// bounds the error of a reported percentile to about 1.5%
+const latencySubBuckets = 64
+
+// latencyHistogram counts latencies in log-linear buckets of microseconds
+type latencyHistogram struct {
+	mu     sync.Mutex
+	counts []int64
+	total  int64
+	max    time.Duration
+}
+
+func latencyBucket(us uint64) int {
+	if us < latencySubBuckets {
+		return int(us)
+	}
+	shift := uint(bits.Len64(us)) - 7 // keep the top 7 bits, the leading one and 6 below it
+	return int(shift+1)*latencySubBuckets + int(us>>shift) - latencySubBuckets
+}
+
+// latencyBucketTop returns the largest latency counted by bucket b
+func latencyBucketTop(b int) time.Duration {
+	if b < latencySubBuckets {
+		return time.Duration(b) * time.Microsecond
+	}
+	shift := uint(b/latencySubBuckets - 1)
+	sub := uint64(b%latencySubBuckets + latencySubBuckets)
+	return time.Duration((sub+1)<<shift-1) * time.Microsecond
+}
+
+func (h *latencyHistogram) add(d time.Duration) {
+	if d < 0 {
+		d = 0
+	}
+	b := latencyBucket(uint64(d / time.Microsecond))
+
+	h.mu.Lock()
+	defer h.mu.Unlock()
+
+	if b >= len(h.counts) {
+		counts := make([]int64, b+1)
+		copy(counts, h.counts)
+		h.counts = counts
+	}
+	h.counts[b]++
+	h.total++
+	if d > h.max {
+		h.max = d
+	}
+}
+
+// percentile returns the latency below which p percent of the samples fall
+func (h *latencyHistogram) percentile(p float64) time.Duration {
+	h.mu.Lock()
+	defer h.mu.Unlock()
+
+	if h.total == 0 {
+		return 0
+	}
+	rank := int64(math.Ceil(p / 100 * float64(h.total)))
+	var seen int64
+	for b, n := range h.counts {
+		if seen += n; seen >= rank {
+			if top := latencyBucketTop(b); top < h.max {
+				return top
+			}
+			return h.max
+		}
+	}
+	return h.max
+}
+
+// LoadConfig describes a load generator run
+type LoadConfig struct {
+	URL      string
+	Endpoint string
+
+	// Rate is the target messages per second across all senders; zero sends as fast as the
+	// senders can, each waiting for its previous send
+	Rate        int
+	Concurrency int
+	Duration    time.Duration
+
+	// Fields is the number of string fields padding each message to about Size bytes
+	Size   int
+	Fields int
+
+	// Drain is how long to wait for messages still in flight after the last send
+	Drain time.Duration
+}
+
+// LoadLatency summarizes a latency distribution
+type LoadLatency struct {
+	P50, P99, P999, Max time.Duration
+}
+
+func (l LoadLatency) String() string {
+	return fmt.Sprintf("p50=%v p99=%v p99.9=%v max=%v", l.P50, l.P99, l.P999, l.Max)
+}
+
+// LoadReport is the outcome of a load generator run. Latency is measured from the actual
+// send; Corrected measures from the time the schedule intended the send, so stalls of the
+// publisher count against every message they delayed instead of hiding them.
+type LoadReport struct {
+	Sent      int64
+	Received  int64
+	Errors    int64
+	Elapsed   time.Duration
+	Latency   LoadLatency
+	Corrected LoadLatency
+}
+
+func (r *LoadReport) String() string {
+	return fmt.Sprintf("sent=%d received=%d errors=%d rate=%.0f/s\nlatency   %v\ncorrected %v",
+		r.Sent, r.Received, r.Errors, float64(r.Sent)/r.Elapsed.Seconds(), r.Latency, r.Corrected)
+}
+
+// loadMessage builds the fields of one load message, padded to about size bytes over n fields
+func loadMessage(run string, seq int64, intended, sent time.Time, size, n int) map[string]interface{} {
+	fields := map[string]interface{}{
+		"loadRun":      run,
+		"loadSeq":      seq,
+		"loadIntended": intended.UnixNano(),
+		"loadSent":     sent.UnixNano(),
+	}
+	if n <= 0 {
+		return fields
+	}
+	per := size / n
+	if per < 1 {
+		per = 1
+	}
+	pad := strings.Repeat("x", per)
+	for i := 0; i < n; i++ {
+		fields[fmt.Sprintf("f%d", i)] = pad
+	}
+	return fields
+}
+
+// RunLoad publishes load messages through the pooled publishers and measures their
+// end-to-end latency at a subscriber on the same endpoint in this process
+func RunLoad(config LoadConfig) (*LoadReport, error) {
+	if config.Concurrency <= 0 {
+		config.Concurrency = 1
+	}
+	if config.Drain <= 0 {
+		config.Drain = 2 * time.Second
+	}
+	conn, err := getRealm(config.URL)
+	if err != nil {
+		return nil, err
+	}
+
+	run := fmt.Sprintf("%s-%d", invalidationOrigin, time.Now().UnixNano())
+	matcher, _ := json.Marshal(map[string]string{"loadRun": run})
+
+	var latency, corrected latencyHistogram
+	report := &LoadReport{}
+	sub, err := NewSubscriber(SubscriberConfig{URL: config.URL, Endpoint: config.Endpoint, Matcher: string(matcher)}, func(fields map[string]interface{}) error {
+		now := time.Now().UnixNano()
+		sent, _ := fields["loadSent"].(int64)
+		intended, _ := fields["loadIntended"].(int64)
+		latency.add(time.Duration(now - sent))
+		corrected.add(time.Duration(now - intended))
+		atomic.AddInt64(&report.Received, 1)
+		return nil
+	})
+	if err != nil {
+		return nil, err
+	}
+	defer sub.Close()
+
+	// the schedule hands out intended send times; a sender that falls behind still
+	// reports against the time its message was due
+	schedule := make(chan time.Time, config.Concurrency)
+	start := time.Now()
+	go func() {
+		defer close(schedule)
+		for i := int64(0); ; i++ {
+			due := time.Now()
+			if config.Rate > 0 {
+				due = start.Add(time.Duration(i) * time.Second / time.Duration(config.Rate))
+				if d := time.Until(due); d > 0 {
+					time.Sleep(d)
+				}
+			}
+			if due.Sub(start) >= config.Duration {
+				return
+			}
+			schedule <- due
+		}
+	}()
+
+	var wg sync.WaitGroup
+	var seq int64
+	for w := 0; w < config.Concurrency; w++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			for intended := range schedule {
+				fields := loadMessage(run, atomic.AddInt64(&seq, 1), intended, time.Now(), config.Size, config.Fields)
+				if err := publishFields(conn, config.Endpoint, fields); err != nil {
+					atomic.AddInt64(&report.Errors, 1)
+					continue
+				}
+				atomic.AddInt64(&report.Sent, 1)
+			}
+		}()
+	}
+	wg.Wait()
+	report.Elapsed = time.Since(start)
+
+	for deadline := time.Now().Add(config.Drain); time.Now().Before(deadline); time.Sleep(10 * time.Millisecond) {
+		if atomic.LoadInt64(&report.Received) >= report.Sent {
+			break
+		}
+	}
+
+	report.Latency = LoadLatency{latency.percentile(50), latency.percentile(99), latency.percentile(99.9), latency.percentile(100)}
+	report.Corrected = LoadLatency{corrected.percentile(50), corrected.percentile(99), corrected.percentile(99.9), corrected.percentile(100)}
+	return report, nil
+}
@@ -0,0 +1,44 @@
+package FTLogo
+
+import (
+	"testing"
+	"time"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func TestLatencyHistogram(t *testing.T) {
+	var h latencyHistogram
+	for i := 1; i <= 1000; i++ {
+		h.add(time.Duration(i) * time.Millisecond)
+	}
+
+	p50, p99 := h.percentile(50), h.percentile(99)
+	assert.True(t, p50 >= 500*time.Millisecond && p50 < 510*time.Millisecond, "p50 %v", p50)
+	assert.True(t, p99 >= 990*time.Millisecond && p99 < 1010*time.Millisecond, "p99 %v", p99)
+	assert.Equal(t, time.Second, h.percentile(100))
+	assert.True(t, h.percentile(99.9) <= time.Second)
+}
+
+func TestLatencyBucketTop(t *testing.T) {
+	for _, us := range []uint64{0, 1, 63, 64, 65, 127, 128, 1000, 123456789} {
+		b := latencyBucket(us)
+		assert.True(t, time.Duration(us)*time.Microsecond <= latencyBucketTop(b), "%d", us)
+		if b > 0 {
+			assert.True(t, time.Duration(us)*time.Microsecond > latencyBucketTop(b-1), "%d", us)
+		}
+	}
+}
+
+func TestLoadMessage(t *testing.T) {
+	now := time.Now()
+	fields := loadMessage("run", 7, now, now, 1000, 4)
+	assert.Len(t, fields, 8)
+	assert.Len(t, fields["f3"], 250)
+
+	data, err := encodeMessage(nil, fields)
+	assert.Nil(t, err)
+	decoded, err := decodeMessage(data)
+	assert.Nil(t, err)
+	assert.Equal(t, now.UnixNano(), decoded["loadSent"])
+}
@@ -0,0 +1,342 @@
+package FTLogo
+
+/*
+#include <stdlib.h>
+#include "tib/ftl.h"
+*/
+import "C"
+
+import (
+	"fmt"
+	"strconv"
+	"sync"
+	"sync/atomic"
+	"time"
+	"unsafe"
+
+	"github.com/TIBCOSoftware/flogo-lib/core/activity"
+)
+
+const (
+	// advisoryEndpoint and the lock advisory fields mirror the constants of tib/advisory.h
+	advisoryEndpoint = "_advisoryEndpoint"
+	lockLostMatcher  = `{"name":"LOCK_LOST"}`
+
+	leaseHold    = 30
+	leaseTimeout = 60
+)
+
+// lockLease keeps a lock handle, and the lock itself, across critical sections of this process.
+// A section owns the lease through its token until it releases it or the lease times out;
+// after release the lock stays held for leaseHold so the next section does not request it again.
+// A LOCK_LOST advisory marks the lease lost and every later use fails until it is re-acquired.
+type lockLease struct {
+	name string
+	conn *realmConn
+	lock C.tibLock
+
+	owner chan struct{}
+
+	mu      sync.Mutex
+	token   string
+	timeout *time.Timer
+	held    bool
+	idle    *time.Timer
+	lost    string
+	losses  uint64
+}
+
+var (
+	leasesMu     sync.Mutex
+	leases       = make(map[string]*lockLease)
+	lockWatchers = make(map[*realmConn]*subscription)
+	leaseSeq     uint64
+)
+
+// getLease returns the lease of a named lock, watching lock advisories of the realm on first use
+func getLease(conn *realmConn, name string) (*lockLease, error) {
+	leasesMu.Lock()
+	defer leasesMu.Unlock()
+
+	if lease, ok := leases[conn.url+"|"+name]; ok {
+		return lease, nil
+	}
+
+	if lockWatchers[conn] == nil {
+		queue, err := conn.sharedQueue()
+		if err != nil {
+			return nil, err
+		}
+		watcher, err := queue.subscribe(subscriberConfig{endpoint: advisoryEndpoint, matcher: lockLostMatcher},
+			func(msgs []*inboundMessage) { onLockLost(conn, msgs) })
+		if err != nil {
+			return nil, err
+		}
+		lockWatchers[conn] = watcher
+	}
+
+	ex := C.tibEx_Create()
+	defer C.tibEx_Destroy(ex)
+
+	cname := C.CString(name)
+	defer C.free(unsafe.Pointer(cname))
+
+	lease := &lockLease{name: name, conn: conn, owner: make(chan struct{}, 1)}
+	lease.lock = C.tibRealm_CreateLock(ex, conn.realm, cname, nil)
+	if err := exError(ex); err != nil {
+		return nil, err
+	}
+	leases[conn.url+"|"+name] = lease
+	return lease, nil
+}
+
+// retireLeases marks the leases of conn lost, so sections running under them fail, and
+// stops watching its lock advisories
+func retireLeases(conn *realmConn) {
+	leasesMu.Lock()
+	defer leasesMu.Unlock()
+
+	for key, lease := range leases {
+		if lease.conn == conn {
+			delete(leases, key)
+			lease.markLost("realm connection replaced")
+		}
+	}
+	if watcher := lockWatchers[conn]; watcher != nil {
+		delete(lockWatchers, conn)
+		watcher.close()
+	}
+}
+
+func onLockLost(conn *realmConn, msgs []*inboundMessage) {
+	for _, m := range msgs {
+		name, _ := m.fields["lock_name"].(string)
+		reason, _ := m.fields["reason"].(string)
+
+		leasesMu.Lock()
+		lease := leases[conn.url+"|"+name]
+		leasesMu.Unlock()
+
+		if lease != nil {
+			log.Warnf("Lock [%s] lost: %s", name, reason)
+			lease.markLost(reason)
+		}
+	}
+}
+
+// acquire waits up to timeout for the in-process ownership of the lease and returns its token.
+// reused reports that the lock was still held from an earlier section, so no request is needed.
+func (l *lockLease) acquire(steal bool, timeout time.Duration) (token string, reused bool, err error) {
+	select {
+	case l.owner <- struct{}{}:
+	case <-time.After(timeout):
+		return "", false, fmt.Errorf("timed out waiting for lock [%s]", l.name)
+	}
+
+	l.mu.Lock()
+	defer l.mu.Unlock()
+
+	l.lost = ""
+	if l.idle != nil {
+		l.idle.Stop()
+		l.idle = nil
+	}
+	if steal {
+		ex := C.tibEx_Create()
+		C.tibLock_Steal(ex, l.lock)
+		err = exError(ex)
+		C.tibEx_Destroy(ex)
+		if err != nil {
+			// the idle hold was stopped above, so nothing else would return the lock
+			if l.held {
+				l.returnLock()
+			}
+			<-l.owner
+			return "", false, err
+		}
+	}
+
+	reused = l.held
+	l.held = true
+	l.token = l.name + "-" + strconv.FormatUint(atomic.AddUint64(&leaseSeq, 1), 10)
+	expired := l.token
+	l.timeout = time.AfterFunc(timeout, func() {
+		log.Warnf("Lease of lock [%s] timed out", l.name)
+		l.release(expired, 0)
+	})
+	return l.token, reused, nil
+}
+
+// use checks that token owns the lease and returns the lock with the loss count to compare
+// against after the critical section
+func (l *lockLease) use(token string) (C.tibLock, uint64, error) {
+	l.mu.Lock()
+	defer l.mu.Unlock()
+
+	if token == "" || token != l.token {
+		return nil, 0, fmt.Errorf("lease [%s] of lock [%s] is no longer owned", token, l.name)
+	}
+	if l.lost != "" {
+		return nil, 0, fmt.Errorf("lock [%s] lost: %s", l.name, l.lost)
+	}
+	l.held = true
+	return l.lock, l.losses, nil
+}
+
+// check fails when token no longer owns the lease, or the lock was lost since use returned losses
+func (l *lockLease) check(token string, losses uint64) error {
+	l.mu.Lock()
+	defer l.mu.Unlock()
+
+	if token != l.token {
+		return fmt.Errorf("lease [%s] of lock [%s] expired during the operation", token, l.name)
+	}
+	if l.losses != losses {
+		return fmt.Errorf("lock [%s] lost during the operation: %s", l.name, l.lost)
+	}
+	return nil
+}
+
+// release gives up the in-process ownership; the lock itself is returned after hold, or at once
+func (l *lockLease) release(token string, hold time.Duration) error {
+	l.mu.Lock()
+	defer l.mu.Unlock()
+
+	if token != l.token {
+		return fmt.Errorf("lease [%s] of lock [%s] is no longer owned", token, l.name)
+	}
+	l.token = ""
+	l.timeout.Stop()
+
+	if l.held {
+		if hold > 0 {
+			l.idle = time.AfterFunc(hold, l.returnIdle)
+		} else {
+			l.returnLock()
+		}
+	}
+	<-l.owner
+	return nil
+}
+
+func (l *lockLease) returnIdle() {
+	l.mu.Lock()
+	defer l.mu.Unlock()
+
+	// a section that started meanwhile took the lease over
+	if l.token == "" && l.idle != nil {
+		l.idle = nil
+		l.returnLock()
+	}
+}
+
+func (l *lockLease) returnLock() {
+	ex := C.tibEx_Create()
+	defer C.tibEx_Destroy(ex)
+
+	C.tibLock_Return(ex, l.lock)
+	if err := exError(ex); err != nil {
+		log.Warnf("Unable to return lock [%s]: %v", l.name, err)
+	}
+	l.held = false
+}
+
+func (l *lockLease) markLost(reason string) {
+	l.mu.Lock()
+	defer l.mu.Unlock()
+
+	l.lost = reason
+	l.losses++
+	l.held = false
+	if l.idle != nil {
+		l.idle.Stop()
+		l.idle = nil
+	}
+}
+
+// evalLockAcquire takes the in-process ownership of a lock and outputs the token of the lease
+func evalLockAcquire(context activity.Context) (done bool, err error) {
+	conn, err := getRealm(inputRealm(context))
+	if err != nil {
+		return false, err
+	}
+	lease, err := getLease(conn, inputString(context, "lockName"))
+	if err != nil {
+		return false, err
+	}
+
+	steal, _ := context.GetInput("steal").(bool)
+	timeout := time.Duration(inputInt(context, "leaseTimeout", leaseTimeout)) * time.Second
+	token, reused, err := lease.acquire(steal, timeout)
+	if err != nil {
+		return false, err
+	}
+
+	context.SetOutput("data", map[string]interface{}{"lock": lease.name, "token": token, "reused": reused})
+	context.SetOutput("result", fmt.Sprintf("lock [%s] acquired", lease.name))
+	return true, nil
+}
+
+// evalLockRelease ends the critical section of a token, keeping the lock for leaseHold seconds
+func evalLockRelease(context activity.Context) (done bool, err error) {
+	conn, err := getRealm(inputRealm(context))
+	if err != nil {
+		return false, err
+	}
+	lease, err := getLease(conn, inputString(context, "lockName"))
+	if err != nil {
+		return false, err
+	}
+
+	hold := time.Duration(inputInt(context, "leaseHold", leaseHold)) * time.Second
+	if err := lease.release(inputString(context, "lockToken"), hold); err != nil {
+		return false, err
+	}
+
+	context.SetOutput("result", fmt.Sprintf("lock [%s] released", lease.name))
+	return true, nil
+}
+
+// enterLease returns the lockToken input, or acquires the lease for a critical section of its
+// own when no token is given; leave releases what enterLease acquired
+func enterLease(context activity.Context, lease *lockLease) (token string, leave func(), err error) {
+	if token = inputString(context, "lockToken"); token != "" {
+		return token, func() {}, nil
+	}
+
+	timeout := time.Duration(inputInt(context, "leaseTimeout", leaseTimeout)) * time.Second
+	if token, _, err = lease.acquire(false, timeout); err != nil {
+		return "", nil, err
+	}
+	hold := time.Duration(inputInt(context, "leaseHold", leaseHold)) * time.Second
+	return token, func() { lease.release(token, hold) }, nil
+}
+
+// withLease runs a map batch under the lock named by the lockName input, if any,
+// failing when the lock is lost before or during the batch
+func withLease(context activity.Context, conn *realmConn, run func(lock C.tibLock) []interface{}) ([]interface{}, error) {
+	name := inputString(context, "lockName")
+	if name == "" {
+		return run(nil), nil
+	}
+
+	lease, err := getLease(conn, name)
+	if err != nil {
+		return nil, err
+	}
+	token, leave, err := enterLease(context, lease)
+	if err != nil {
+		return nil, err
+	}
+	defer leave()
+
+	lock, losses, err := lease.use(token)
+	if err != nil {
+		return nil, err
+	}
+	results := run(lock)
+	if err := lease.check(token, losses); err != nil {
+		return nil, err
+	}
+	return results, nil
+}
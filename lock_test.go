@@ -0,0 +1,72 @@
+package FTLogo
+
+import (
+	"testing"
+	"time"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func TestLockLeaseReuse(t *testing.T) {
+	l := &lockLease{name: "l", owner: make(chan struct{}, 1)}
+
+	token, reused, err := l.acquire(false, time.Second)
+	assert.Nil(t, err)
+	assert.False(t, reused)
+
+	// only the owning token may use the lease
+	_, _, err = l.use("")
+	assert.NotNil(t, err)
+	_, _, err = l.use("other")
+	assert.NotNil(t, err)
+
+	// a second section waits for the first one
+	_, _, err = l.acquire(false, 10*time.Millisecond)
+	assert.NotNil(t, err)
+
+	assert.Nil(t, l.release(token, time.Minute))
+	assert.NotNil(t, l.release(token, time.Minute))
+
+	token, reused, err = l.acquire(false, time.Second)
+	assert.Nil(t, err)
+	assert.True(t, reused)
+	assert.Nil(t, l.release(token, time.Minute))
+}
+
+func TestLockLeaseLost(t *testing.T) {
+	l := &lockLease{name: "l", owner: make(chan struct{}, 1)}
+
+	token, _, err := l.acquire(false, time.Second)
+	assert.Nil(t, err)
+	_, losses, err := l.use(token)
+	assert.Nil(t, err)
+
+	l.markLost("LOCK_STOLEN")
+	assert.NotNil(t, l.check(token, losses))
+	_, _, err = l.use(token)
+	assert.NotNil(t, err)
+	assert.Nil(t, l.release(token, time.Minute))
+
+	// re-acquiring clears the loss but cannot reuse the lock
+	token, reused, err := l.acquire(false, time.Second)
+	assert.Nil(t, err)
+	assert.False(t, reused)
+	_, _, err = l.use(token)
+	assert.Nil(t, err)
+	assert.Nil(t, l.release(token, 0))
+}
+
+func TestLockLeaseTimeout(t *testing.T) {
+	l := &lockLease{name: "l", owner: make(chan struct{}, 1)}
+
+	token, _, err := l.acquire(false, 10*time.Millisecond)
+	assert.Nil(t, err)
+	_, losses, err := l.use(token)
+	assert.Nil(t, err)
+	assert.Nil(t, l.check(token, losses))
+
+	// a section outliving its lease fails even though the lock was never lost
+	time.Sleep(50 * time.Millisecond)
+	assert.NotNil(t, l.check(token, losses))
+	assert.NotNil(t, l.release(token, 0))
+}
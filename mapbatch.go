@@ -0,0 +1,637 @@
+package FTLogo
+
+/*
+#include <stdlib.h>
+#include <string.h>
+#include "ftlogo.h"
+
+#define RESULT_OK        0
+#define RESULT_NOT_FOUND 1
+#define RESULT_ERROR     2
+
+#define ERROR_TEXT_SIZE  1024
+
+// The most a set or remove result takes: status byte, text length and error text
+#define MAX_STATUS_SIZE  (1 + 4 + ERROR_TEXT_SIZE)
+
+// Records the pending exception as the result of the current key and clears it
+static void putError(tibEx ex, ftlogoBuf *b)
+{
+    char    text[ERROR_TEXT_SIZE];
+    uint8_t status = RESULT_ERROR;
+
+    tibEx_ToString(ex, text, sizeof(text));
+    tibEx_Clear(ex);
+    ftlogoBuf_Put(b, &status, 1);
+    ftlogoBuf_PutString(b, text, -1);
+}
+
+// Gets n keys, given as consecutive NUL terminated strings, writing one status byte
+// per key followed by the encoded value or the error text.
+// Returns the number of keys done; *used is the length needed when the first key did not fit.
+// A non-NULL lock makes every call a *WithLock call.
+static int getBatch(tibEx ex, tibMap map, tibLock lock, const char *keys, int n,
+                    char *data, int cap, int *used)
+{
+    ftlogoBuf   b = { data, cap, 0 };
+    tibMessage  msg;
+    uint8_t     status;
+    int         i, mark;
+
+    for (i = 0; i < n; i++, keys += strlen(keys) + 1)
+    {
+        mark = b.len;
+        if (lock != NULL)
+            msg = tibMap_GetWithLock(ex, map, keys, lock);
+        else
+            msg = tibMap_Get(ex, map, keys);
+        if (tibEx_GetErrorCode(ex) != TIB_OK)
+            putError(ex, &b);
+        else if (msg == NULL)
+        {
+            status = RESULT_NOT_FOUND;
+            ftlogoBuf_Put(&b, &status, 1);
+        }
+        else
+        {
+            status = RESULT_OK;
+            ftlogoBuf_Put(&b, &status, 1);
+            ftlogoMessage_Encode(ex, msg, &b);
+            if (tibEx_GetErrorCode(ex) != TIB_OK)
+            {
+                b.len = mark;
+                putError(ex, &b);
+            }
+            tibMessage_Destroy(ex, msg);
+        }
+        if (b.len > b.cap)
+        {
+            if (i == 0)
+            {
+                *used = b.len;
+                return 0;
+            }
+            b.len = mark;
+            break;
+        }
+    }
+    *used = b.len;
+    return i;
+}
+
+// Sets n keys to the length-prefixed values encoded back to back in values,
+// writing one status byte per key followed by the error text on failure.
+// A key is only written while its result is sure to fit, so every key done has its result;
+// *used is the length needed when not even the first key fit.
+static int setBatch(tibEx ex, tibRealm realm, tibMap map, tibLock lock, const char *keys, int n,
+                    const char *values, int valuesLen, char *data, int cap, int *used)
+{
+    ftlogoBuf       b = { data, cap, 0 };
+    ftlogoReader    r = { values, valuesLen, 0 };
+    tibMessage      msg;
+    uint8_t         status = RESULT_OK;
+    int             i, bad;
+
+    for (i = 0; i < n; i++, keys += strlen(keys) + 1)
+    {
+        if (b.cap - b.len < MAX_STATUS_SIZE)
+            break;
+        msg = ftlogoMessage_Decode(ex, realm, &r, &bad);
+        if (bad)
+            return -1;
+        if (msg != NULL && lock != NULL)
+            tibMap_SetWithLock(ex, map, keys, msg, lock);
+        else if (msg != NULL)
+            tibMap_Set(ex, map, keys, msg);
+        if (tibEx_GetErrorCode(ex) != TIB_OK)
+            putError(ex, &b);
+        else
+            ftlogoBuf_Put(&b, &status, 1);
+        if (msg != NULL)
+            tibMessage_Destroy(ex, msg);
+    }
+    *used = i == 0 ? MAX_STATUS_SIZE : b.len;
+    return i;
+}
+
+// Removes n keys, writing one status byte per key followed by the error text on failure.
+// Like setBatch, a key is only removed while its result is sure to fit.
+static int removeBatch(tibEx ex, tibMap map, tibLock lock, const char *keys, int n,
+                       char *data, int cap, int *used)
+{
+    ftlogoBuf   b = { data, cap, 0 };
+    uint8_t     status = RESULT_OK;
+    int         i;
+
+    for (i = 0; i < n; i++, keys += strlen(keys) + 1)
+    {
+        if (b.cap - b.len < MAX_STATUS_SIZE)
+            break;
+        if (lock != NULL)
+            tibMap_RemoveWithLock(ex, map, keys, lock);
+        else
+            tibMap_Remove(ex, map, keys);
+        if (tibEx_GetErrorCode(ex) != TIB_OK)
+            putError(ex, &b);
+        else
+            ftlogoBuf_Put(&b, &status, 1);
+    }
+    *used = i == 0 ? MAX_STATUS_SIZE : b.len;
+    return i;
+}
+*/
+import "C"
+
+import (
+	"bytes"
+	"errors"
+	"fmt"
+	"runtime"
+	"strconv"
+	"sync"
+	"time"
+	"unsafe"
+
+	"github.com/TIBCOSoftware/flogo-lib/core/activity"
+)
+
+const (
+	mapWorkers       = 4
+	mapChunkSize     = 64
+	mapResultBufSize = 64 * 1024
+)
+
+const (
+	resultOK       = 0
+	resultNotFound = 1
+	resultError    = 2
+)
+
+const (
+	mapOpGet = iota
+	mapOpSet
+	mapOpRemove
+)
+
+// mapJob is a contiguous slice of a batch processed by one worker in a single cgo call
+type mapJob struct {
+	op      int
+	keys    []string
+	values  [][]byte
+	lock    C.tibLock
+	results []interface{}
+	wg      *sync.WaitGroup
+}
+
+// mapPool fans batches out across workers that each own a thread and a map handle
+type mapPool struct {
+	conn *realmConn
+	jobs chan *mapJob
+
+	// mu keeps retire from closing jobs while a batch is running
+	mu      sync.RWMutex
+	retired bool
+}
+
+var (
+	mapPoolsMu sync.Mutex
+	mapPools   = make(map[string]*mapPool)
+)
+
+// evalMapGet reads every key of the keys input, returning results in input order.
+// With a cacheTTL, values are served from the near cache and only misses reach the map;
+// reads under a lock always go to the map.
+func evalMapGet(context activity.Context) (done bool, err error) {
+	keys, err := inputStrings(context, "keys")
+	if err != nil {
+		return false, err
+	}
+	pool, conn, err := getMapPool(context)
+	if err != nil {
+		return false, err
+	}
+
+	var results []interface{}
+	if ttl := inputInt(context, "cacheTTL", 0); ttl > 0 && inputString(context, "lockName") == "" {
+		cache, err := getNearCache(conn, inputString(context, "endpoint"), inputString(context, "mapName"),
+			time.Duration(ttl)*time.Second, inputString(context, "invalidationEndpoint"))
+		if err != nil {
+			return false, err
+		}
+		results = getThroughCache(pool, cache, time.Duration(ttl)*time.Second, keys)
+	} else {
+		results, err = withLease(context, conn, func(lock C.tibLock) []interface{} {
+			return pool.run(mapOpGet, keys, nil, lock)
+		})
+		if err != nil {
+			return false, err
+		}
+	}
+
+	context.SetOutput("data", results)
+	context.SetOutput("result", fmt.Sprintf("map get returned %d results", len(results)))
+	return true, nil
+}
+
+// getThroughCache answers hits no older than ttl from the cache and fetches the misses in one pipelined batch
+func getThroughCache(pool *mapPool, cache *nearCache, ttl time.Duration, keys []string) []interface{} {
+	results := make([]interface{}, len(keys))
+
+	var (
+		missKeys []string
+		missIdx  []int
+		missSeq  []uint64
+	)
+	for i, key := range keys {
+		if value, seq, hit := cache.lookup(key, ttl); hit {
+			results[i] = map[string]interface{}{"key": key, "found": true, "value": value}
+		} else {
+			missKeys = append(missKeys, key)
+			missIdx = append(missIdx, i)
+			missSeq = append(missSeq, seq)
+		}
+	}
+
+	if len(missKeys) > 0 {
+		for j, r := range pool.run(mapOpGet, missKeys, nil, nil) {
+			result := r.(map[string]interface{})
+			if value, ok := result["value"].(map[string]interface{}); ok {
+				cache.fill(missKeys[j], value, missSeq[j])
+			}
+			results[missIdx[j]] = result
+		}
+	}
+	return results
+}
+
+// evalMapSet stores every entry of the entries input, returning per-key outcomes in input order
+func evalMapSet(context activity.Context) (done bool, err error) {
+	keys, values, err := inputEntries(context, "entries")
+	if err != nil {
+		return false, err
+	}
+	pool, conn, err := getMapPool(context)
+	if err != nil {
+		return false, err
+	}
+
+	encoded := make([][]byte, len(values))
+	for i, value := range values {
+		if encoded[i], err = encodeMessage(nil, value); err != nil {
+			return false, fmt.Errorf("value of key [%s]: %v", keys[i], err)
+		}
+	}
+
+	results, err := withLease(context, conn, func(lock C.tibLock) []interface{} {
+		return pool.run(mapOpSet, keys, encoded, lock)
+	})
+	if err != nil {
+		return false, err
+	}
+	if err := invalidateWritten(context, conn, keys, results); err != nil {
+		return false, err
+	}
+
+	context.SetOutput("data", results)
+	context.SetOutput("result", fmt.Sprintf("map set stored %d entries", len(results)))
+	return true, nil
+}
+
+// evalMapRemove removes every key of the keys input, returning per-key outcomes in input order
+func evalMapRemove(context activity.Context) (done bool, err error) {
+	keys, err := inputStrings(context, "keys")
+	if err != nil {
+		return false, err
+	}
+	pool, conn, err := getMapPool(context)
+	if err != nil {
+		return false, err
+	}
+
+	results, err := withLease(context, conn, func(lock C.tibLock) []interface{} {
+		return pool.run(mapOpRemove, keys, nil, lock)
+	})
+	if err != nil {
+		return false, err
+	}
+	if err := invalidateWritten(context, conn, keys, results); err != nil {
+		return false, err
+	}
+
+	context.SetOutput("data", results)
+	context.SetOutput("result", fmt.Sprintf("map remove removed %d keys", len(results)))
+	return true, nil
+}
+
+// invalidateWritten publishes one invalidation for every key the batch changed
+func invalidateWritten(context activity.Context, conn *realmConn, keys []string, results []interface{}) error {
+	var written []string
+	for i, r := range results {
+		if _, failed := r.(map[string]interface{})["error"]; !failed {
+			written = append(written, keys[i])
+		}
+	}
+	return publishInvalidation(conn, inputString(context, "endpoint"), inputString(context, "mapName"),
+		inputString(context, "invalidationEndpoint"), written)
+}
+
+// inputEntries reads key/value pairs given either as an object or as an array of {key, value} objects
+func inputEntries(context activity.Context, name string) (keys []string, values []map[string]interface{}, err error) {
+	switch entries := context.GetInput(name).(type) {
+	case map[string]interface{}:
+		for key, value := range entries {
+			fields, ok := value.(map[string]interface{})
+			if !ok {
+				return nil, nil, fmt.Errorf("value of key [%s] is not an object", key)
+			}
+			keys = append(keys, key)
+			values = append(values, fields)
+		}
+	case []interface{}:
+		for i, entry := range entries {
+			pair, _ := entry.(map[string]interface{})
+			key, _ := pair["key"].(string)
+			fields, ok := pair["value"].(map[string]interface{})
+			if key == "" || !ok {
+				return nil, nil, fmt.Errorf("entry %d is not a {key, value} object", i)
+			}
+			keys = append(keys, key)
+			values = append(values, fields)
+		}
+	case nil:
+	default:
+		return nil, nil, fmt.Errorf("input [%s] must be an object or an array", name)
+	}
+	return keys, values, nil
+}
+
+func getMapPool(context activity.Context) (*mapPool, *realmConn, error) {
+	url := inputRealm(context)
+	endpoint := inputString(context, "endpoint")
+	mapName := inputString(context, "mapName")
+	workers := inputInt(context, "workers", mapWorkers)
+	if workers <= 0 {
+		workers = mapWorkers
+	}
+	key := realmKey(url) + "|" + endpoint + "|" + mapName + "|" + strconv.Itoa(workers)
+
+	conn, err := getRealm(url)
+	if err != nil {
+		return nil, nil, err
+	}
+
+	mapPoolsMu.Lock()
+	defer mapPoolsMu.Unlock()
+
+	if pool, ok := mapPools[key]; ok {
+		return pool, conn, nil
+	}
+	if err := conn.checkLive(); err != nil {
+		return nil, nil, err
+	}
+
+	pool, err := newMapPool(conn, endpoint, mapName, workers)
+	if err != nil {
+		return nil, nil, err
+	}
+	mapPools[key] = pool
+	return pool, conn, nil
+}
+
+func newMapPool(conn *realmConn, endpoint, mapName string, workers int) (*mapPool, error) {
+	if workers <= 0 {
+		workers = mapWorkers
+	}
+
+	pool := &mapPool{conn: conn, jobs: make(chan *mapJob, workers*2)}
+	started := make(chan error, workers)
+	for i := 0; i < workers; i++ {
+		go pool.work(conn, endpoint, mapName, started)
+	}
+
+	var err error
+	for i := 0; i < workers; i++ {
+		if e := <-started; e != nil {
+			err = e
+		}
+	}
+	if err != nil {
+		close(pool.jobs)
+		return nil, err
+	}
+	return pool, nil
+}
+
+// run splits the batch into chunks so every worker keeps a map call in flight;
+// a non-nil lock makes every map call a *WithLock call
+func (pool *mapPool) run(op int, keys []string, values [][]byte, lock C.tibLock) []interface{} {
+	results := make([]interface{}, len(keys))
+
+	pool.mu.RLock()
+	defer pool.mu.RUnlock()
+
+	if pool.retired {
+		for i, key := range keys {
+			results[i] = map[string]interface{}{"key": key, "error": "map pool retired with its realm connection"}
+		}
+		return results
+	}
+
+	var wg sync.WaitGroup
+	for start := 0; start < len(keys); start += mapChunkSize {
+		end := start + mapChunkSize
+		if end > len(keys) {
+			end = len(keys)
+		}
+		job := &mapJob{op: op, keys: keys[start:end], lock: lock, results: results[start:end], wg: &wg}
+		if values != nil {
+			job.values = values[start:end]
+		}
+		wg.Add(1)
+		pool.jobs <- job
+	}
+	wg.Wait()
+
+	return results
+}
+
+// retireMapPools stops the workers of conn once their batches are done, closing their maps
+func retireMapPools(conn *realmConn) {
+	mapPoolsMu.Lock()
+	var retired []*mapPool
+	for key, pool := range mapPools {
+		if pool.conn == conn {
+			delete(mapPools, key)
+			retired = append(retired, pool)
+		}
+	}
+	mapPoolsMu.Unlock()
+
+	for _, pool := range retired {
+		pool.mu.Lock()
+		pool.retired = true
+		close(pool.jobs)
+		pool.mu.Unlock()
+	}
+}
+
+// work owns one map handle on a locked thread for the life of the pool
+func (pool *mapPool) work(conn *realmConn, endpoint, mapName string, started chan<- error) {
+	runtime.LockOSThread()
+	defer runtime.UnlockOSThread()
+
+	ex := C.tibEx_Create()
+	defer C.tibEx_Destroy(ex)
+
+	cendpoint := cStringOrNil(endpoint)
+	cmapName := C.CString(mapName)
+	tmap := C.tibRealm_CreateMap(ex, conn.realm, cendpoint, cmapName, nil)
+	C.free(unsafe.Pointer(cendpoint))
+	C.free(unsafe.Pointer(cmapName))
+
+	if err := exError(ex); err != nil {
+		started <- err
+		return
+	}
+	started <- nil
+
+	size := mapResultBufSize
+	buf := C.malloc(C.size_t(size))
+
+	for job := range pool.jobs {
+		var err error
+		switch job.op {
+		case mapOpGet:
+			size, buf, err = job.get(ex, tmap, size, buf)
+		case mapOpSet:
+			size, buf, err = job.set(ex, conn.realm, tmap, size, buf)
+		case mapOpRemove:
+			size, buf, err = job.remove(ex, tmap, size, buf)
+		}
+		if err != nil {
+			for i := range job.results {
+				if job.results[i] == nil {
+					job.results[i] = map[string]interface{}{"key": job.keys[i], "error": err.Error()}
+				}
+			}
+		}
+		job.wg.Done()
+	}
+
+	C.free(buf)
+	C.tibEx_Clear(ex)
+	C.tibMap_Close(ex, tmap)
+}
+
+// joinKeys lays keys out as consecutive NUL terminated strings in C memory
+func joinKeys(keys []string) unsafe.Pointer {
+	var b bytes.Buffer
+	for _, key := range keys {
+		b.WriteString(key)
+		b.WriteByte(0)
+	}
+	return C.CBytes(b.Bytes())
+}
+
+func (job *mapJob) get(ex C.tibEx, tmap C.tibMap, size int, buf unsafe.Pointer) (int, unsafe.Pointer, error) {
+	for done := 0; done < len(job.keys); {
+		ckeys := joinKeys(job.keys[done:])
+		var used C.int
+		n := int(C.getBatch(ex, tmap, job.lock, (*C.char)(ckeys), C.int(len(job.keys)-done), (*C.char)(buf), C.int(size), &used))
+		C.free(ckeys)
+
+		if n == 0 {
+			C.free(buf)
+			size = int(used) * 2
+			buf = C.malloc(C.size_t(size))
+			continue
+		}
+
+		r := &fieldReader{data: (*[1 << 30]byte)(buf)[:used:used]}
+		for i := done; i < done+n; i++ {
+			job.results[i] = readMapResult(r, job.keys[i], true)
+		}
+		if r.err != nil {
+			return size, buf, r.err
+		}
+		done += n
+	}
+	return size, buf, nil
+}
+
+func (job *mapJob) set(ex C.tibEx, realm C.tibRealm, tmap C.tibMap, size int, buf unsafe.Pointer) (int, unsafe.Pointer, error) {
+	for done := 0; done < len(job.keys); {
+		ckeys := joinKeys(job.keys[done:])
+		values := bytes.Join(job.values[done:], nil)
+		cvalues := C.CBytes(values)
+		var used C.int
+		n := int(C.setBatch(ex, realm, tmap, job.lock, (*C.char)(ckeys), C.int(len(job.keys)-done),
+			(*C.char)(cvalues), C.int(len(values)), (*C.char)(buf), C.int(size), &used))
+		C.free(ckeys)
+		C.free(cvalues)
+
+		if n < 0 {
+			return size, buf, errors.New("malformed value encoding")
+		}
+		if n == 0 {
+			C.free(buf)
+			size = int(used) * 2
+			buf = C.malloc(C.size_t(size))
+			continue
+		}
+
+		r := &fieldReader{data: (*[1 << 30]byte)(buf)[:used:used]}
+		for i := done; i < done+n; i++ {
+			job.results[i] = readMapResult(r, job.keys[i], false)
+		}
+		if r.err != nil {
+			return size, buf, r.err
+		}
+		done += n
+	}
+	return size, buf, nil
+}
+
+func (job *mapJob) remove(ex C.tibEx, tmap C.tibMap, size int, buf unsafe.Pointer) (int, unsafe.Pointer, error) {
+	for done := 0; done < len(job.keys); {
+		ckeys := joinKeys(job.keys[done:])
+		var used C.int
+		n := int(C.removeBatch(ex, tmap, job.lock, (*C.char)(ckeys), C.int(len(job.keys)-done), (*C.char)(buf), C.int(size), &used))
+		C.free(ckeys)
+
+		if n == 0 {
+			C.free(buf)
+			size = int(used) * 2
+			buf = C.malloc(C.size_t(size))
+			continue
+		}
+
+		r := &fieldReader{data: (*[1 << 30]byte)(buf)[:used:used]}
+		for i := done; i < done+n; i++ {
+			job.results[i] = readMapResult(r, job.keys[i], false)
+		}
+		if r.err != nil {
+			return size, buf, r.err
+		}
+		done += n
+	}
+	return size, buf, nil
+}
+
+// readMapResult converts one status byte and its payload into a per-key result;
+// successful gets carry the value, successful sets carry nothing
+func readMapResult(r *fieldReader, key string, hasValue bool) map[string]interface{} {
+	result := map[string]interface{}{"key": key}
+	switch r.u8() {
+	case resultOK:
+		if hasValue {
+			result["found"] = true
+			result["value"] = r.message()
+		}
+	case resultNotFound:
+		result["found"] = false
+	case resultError:
+		result["error"] = r.str()
+	}
+	return result
+}
@@ -0,0 +1,43 @@
+package FTLogo
+
+import (
+	"testing"
+
+	"github.com/TIBCOSoftware/flogo-contrib/action/flow/test"
+	"github.com/stretchr/testify/assert"
+)
+
+func TestInputEntries(t *testing.T) {
+	tc := test.NewTestActivityContext(getActivityMetadata())
+	tc.SetInput("entries", []interface{}{
+		map[string]interface{}{"key": "a", "value": map[string]interface{}{"n": float64(1)}},
+		map[string]interface{}{"key": "b", "value": map[string]interface{}{"n": float64(2)}},
+	})
+
+	keys, values, err := inputEntries(tc, "entries")
+	assert.Nil(t, err)
+	assert.Equal(t, []string{"a", "b"}, keys)
+	assert.Equal(t, float64(2), values[1]["n"])
+
+	tc.SetInput("entries", []interface{}{"a"})
+	_, _, err = inputEntries(tc, "entries")
+	assert.NotNil(t, err)
+}
+
+func TestReadMapResult(t *testing.T) {
+	b := &encodingBuilder{}
+	b.WriteByte(resultOK)
+	b.message(func(m *encodingBuilder) {
+		m.field(fieldString, "s")
+		m.str("v")
+	})
+	b.WriteByte(resultNotFound)
+	b.WriteByte(resultError)
+	b.str("boom")
+
+	r := &fieldReader{data: b.Bytes()}
+	assert.Equal(t, map[string]interface{}{"key": "a", "found": true, "value": map[string]interface{}{"s": "v"}}, readMapResult(r, "a", true))
+	assert.Equal(t, map[string]interface{}{"key": "b", "found": false}, readMapResult(r, "b", true))
+	assert.Equal(t, map[string]interface{}{"key": "c", "error": "boom"}, readMapResult(r, "c", true))
+	assert.Nil(t, r.err)
+}
@@ -0,0 +1,338 @@
+package FTLogo
+
+/*
+#include <stdlib.h>
+#include <string.h>
+#include "ftlogo.h"
+
+// Encodes up to maxEntries key/value pairs whose key starts with prefix into data.
+// *state is 0 when the iterator must advance, 1 when the current pair did not fit
+// the previous buffer and is still pending, and 2 once the iteration is finished.
+// *used reports the encoded length, or the length needed when a single pair did not fit.
+static int scanBatch(tibEx ex, tibMapIterator it, const char *prefix, int maxEntries,
+                     char *data, int cap, int *used, int *state)
+{
+    ftlogoBuf   b = { data, cap, 0 };
+    size_t      prefixLen = prefix ? strlen(prefix) : 0;
+    const char  *key;
+    int         count = 0;
+    int         mark;
+
+    while (count < maxEntries)
+    {
+        if (*state != 1 && !tibMapIterator_Next(ex, it))
+        {
+            if (tibEx_GetErrorCode(ex) == TIB_OK)
+                *state = 2;
+            break;
+        }
+        *state = 0;
+
+        key = tibMapIterator_CurrentKey(ex, it);
+        if (key == NULL || strncmp(key, prefix, prefixLen) != 0)
+            continue;
+
+        mark = b.len;
+        ftlogoBuf_PutString(&b, key, -1);
+        ftlogoMessage_Encode(ex, tibMapIterator_CurrentValue(ex, it), &b);
+        if (tibEx_GetErrorCode(ex) != TIB_OK)
+            break;
+        if (b.len > b.cap)
+        {
+            *state = 1;
+            if (count == 0)
+            {
+                *used = b.len;
+                return 0;
+            }
+            b.len = mark;
+            break;
+        }
+        count++;
+    }
+    *used = b.len;
+    return count;
+}
+*/
+import "C"
+
+import (
+	"errors"
+	"fmt"
+	"runtime"
+	"sync"
+	"sync/atomic"
+	"time"
+	"unsafe"
+
+	"github.com/TIBCOSoftware/flogo-lib/core/activity"
+)
+
+const (
+	scanBatchSize   = 1000
+	scanPrefetch    = 4
+	scanBufferSize  = 1 << 20
+	scanIdleTimeout = 5 * time.Minute
+)
+
+// scanBatch is one chunk of map entries handed from the scan thread to Eval
+type scanBatch struct {
+	entries []interface{}
+	last    bool
+}
+
+// mapScan iterates a map on its own thread, keeping up to prefetch batches ready for the flow
+type mapScan struct {
+	id       string
+	conn     *realmConn
+	batches  chan *scanBatch
+	stop     chan struct{}
+	stopOnce sync.Once
+	err      error
+	lastPoll int64
+
+	// retired is set when the realm connection of the scan was retired under it
+	retired int32
+}
+
+var (
+	scansMu sync.Mutex
+	scans   = make(map[string]*mapScan)
+	scanSeq uint64
+)
+
+// evalMapScan returns the next batch of the scan named by the cursor input,
+// starting a new scan when no cursor is given
+func evalMapScan(context activity.Context) (done bool, err error) {
+	cursor := inputString(context, "cursor")
+
+	var scan *mapScan
+	if cursor == "" {
+		url := inputRealm(context)
+		conn, err := getRealm(url)
+		if err != nil {
+			return false, err
+		}
+		scan, err = startMapScan(conn,
+			inputString(context, "endpoint"),
+			inputString(context, "mapName"),
+			inputString(context, "keyPrefix"),
+			inputInt(context, "batchSize", scanBatchSize),
+			inputInt(context, "prefetch", scanPrefetch))
+		if err != nil {
+			return false, err
+		}
+	} else {
+		scansMu.Lock()
+		scan = scans[cursor]
+		scansMu.Unlock()
+		if scan == nil {
+			return false, fmt.Errorf("unknown or expired map scan cursor [%s]", cursor)
+		}
+	}
+
+	atomic.StoreInt64(&scan.lastPoll, time.Now().UnixNano())
+	batch, ok := <-scan.batches
+	if !ok || batch.last {
+		scan.close()
+		if scan.err != nil {
+			return false, scan.err
+		}
+		if !ok && atomic.LoadInt32(&scan.retired) != 0 {
+			return false, fmt.Errorf("map scan [%s] ended early: its realm connection was replaced", scan.id)
+		}
+	}
+
+	var entries []interface{}
+	if ok {
+		entries = batch.entries
+	}
+	if entries == nil {
+		entries = []interface{}{}
+	}
+
+	context.SetOutput("data", entries)
+	if ok && !batch.last {
+		context.SetOutput("cursor", scan.id)
+		context.SetOutput("done", false)
+	} else {
+		context.SetOutput("cursor", "")
+		context.SetOutput("done", true)
+	}
+	context.SetOutput("result", fmt.Sprintf("map scan returned %d entries", len(entries)))
+
+	return true, nil
+}
+
+func startMapScan(conn *realmConn, endpoint, mapName, prefix string, batchSize, prefetch int) (*mapScan, error) {
+	if batchSize <= 0 {
+		batchSize = scanBatchSize
+	}
+	if prefetch <= 0 {
+		prefetch = scanPrefetch
+	}
+
+	scan := &mapScan{
+		id:       fmt.Sprintf("scan-%d", atomic.AddUint64(&scanSeq, 1)),
+		conn:     conn,
+		batches:  make(chan *scanBatch, prefetch),
+		stop:     make(chan struct{}),
+		lastPoll: time.Now().UnixNano(),
+	}
+
+	scansMu.Lock()
+	if err := conn.checkLive(); err != nil {
+		scansMu.Unlock()
+		return nil, err
+	}
+	scans[scan.id] = scan
+	scansMu.Unlock()
+
+	go scan.run(conn, endpoint, mapName, prefix, batchSize)
+	go scan.watch()
+
+	log.Debugf("Started map scan [%s] of map [%s] with prefix [%s]", scan.id, mapName, prefix)
+	return scan, nil
+}
+
+// retireMapScans stops the scans of conn before their next cursor step; their flows get
+// an error instead of a silently truncated scan
+func retireMapScans(conn *realmConn) {
+	scansMu.Lock()
+	var retired []*mapScan
+	for _, scan := range scans {
+		if scan.conn == conn {
+			retired = append(retired, scan)
+		}
+	}
+	scansMu.Unlock()
+
+	for _, scan := range retired {
+		atomic.StoreInt32(&scan.retired, 1)
+		scan.close()
+	}
+}
+
+// close stops the scan thread and forgets the cursor
+func (scan *mapScan) close() {
+	scan.stopOnce.Do(func() {
+		close(scan.stop)
+		scansMu.Lock()
+		delete(scans, scan.id)
+		scansMu.Unlock()
+	})
+}
+
+// watch abandons scans whose flow stopped polling them
+func (scan *mapScan) watch() {
+	ticker := time.NewTicker(scanIdleTimeout / 4)
+	defer ticker.Stop()
+
+	for {
+		select {
+		case <-scan.stop:
+			return
+		case <-ticker.C:
+			if time.Since(time.Unix(0, atomic.LoadInt64(&scan.lastPoll))) > scanIdleTimeout {
+				log.Warnf("Abandoning idle map scan [%s]", scan.id)
+				scan.close()
+				return
+			}
+		}
+	}
+}
+
+// run iterates the map, encoding whole batches in C so the scan costs one cgo call per batch
+func (scan *mapScan) run(conn *realmConn, endpoint, mapName, prefix string, batchSize int) {
+	runtime.LockOSThread()
+	defer runtime.UnlockOSThread()
+	defer close(scan.batches)
+
+	ex := C.tibEx_Create()
+	defer C.tibEx_Destroy(ex)
+
+	cendpoint := cStringOrNil(endpoint)
+	defer C.free(unsafe.Pointer(cendpoint))
+	cmapName := C.CString(mapName)
+	defer C.free(unsafe.Pointer(cmapName))
+	cprefix := C.CString(prefix)
+	defer C.free(unsafe.Pointer(cprefix))
+
+	tmap := C.tibRealm_CreateMap(ex, conn.realm, cendpoint, cmapName, nil)
+	if scan.err = exError(ex); scan.err != nil {
+		return
+	}
+	it := C.tibMap_CreateIterator(ex, tmap, nil)
+	if scan.err = exError(ex); scan.err != nil {
+		C.tibEx_Clear(ex)
+		C.tibMap_Close(ex, tmap)
+		return
+	}
+	defer func() {
+		C.tibEx_Clear(ex)
+		C.tibMapIterator_Destroy(ex, it)
+		C.tibMap_Close(ex, tmap)
+	}()
+
+	size := scanBufferSize
+	buf := C.malloc(C.size_t(size))
+	defer func() { C.free(buf) }()
+
+	var state, used C.int
+	for {
+		select {
+		case <-scan.stop:
+			return
+		default:
+		}
+		n := C.scanBatch(ex, it, cprefix, C.int(batchSize), (*C.char)(buf), C.int(size), &used, &state)
+		if scan.err = exError(ex); scan.err != nil {
+			return
+		}
+		if n == 0 && state == 1 {
+			// a single entry is larger than the buffer
+			C.free(buf)
+			size = int(used) * 2
+			buf = C.malloc(C.size_t(size))
+			continue
+		}
+
+		batch := &scanBatch{last: state == 2}
+		batch.entries, scan.err = decodeScanBatch((*[1 << 30]byte)(buf)[:used:used], int(n))
+		if scan.err != nil {
+			return
+		}
+
+		select {
+		case scan.batches <- batch:
+		case <-scan.stop:
+			return
+		}
+		if batch.last {
+			return
+		}
+	}
+}
+
+// decodeScanBatch converts the key/value pairs written by scanBatch into flow data
+func decodeScanBatch(data []byte, n int) ([]interface{}, error) {
+	r := &fieldReader{data: data}
+	entries := make([]interface{}, 0, n)
+	for i := 0; i < n && r.err == nil; i++ {
+		key := r.str()
+		value := r.message()
+		entries = append(entries, map[string]interface{}{"key": key, "value": value})
+	}
+	if r.err == nil && r.pos != len(data) {
+		r.err = errors.New("unexpected data after map scan batch")
+	}
+	return entries, r.err
+}
+
+// cStringOrNil returns NULL for an empty string so FTL applies its default
+func cStringOrNil(s string) *C.char {
+	if s == "" {
+		return nil
+	}
+	return C.CString(s)
+}
@@ -0,0 +1,25 @@
+package FTLogo
+
+import (
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func TestDecodeScanBatch(t *testing.T) {
+	b := &encodingBuilder{}
+	for _, key := range []string{"k1", "k2"} {
+		b.str(key)
+		b.message(func(m *encodingBuilder) {
+			m.field(fieldString, "key")
+			m.str(key)
+		})
+	}
+
+	entries, err := decodeScanBatch(b.Bytes(), 2)
+	assert.Nil(t, err)
+	assert.Equal(t, []interface{}{
+		map[string]interface{}{"key": "k1", "value": map[string]interface{}{"key": "k1"}},
+		map[string]interface{}{"key": "k2", "value": map[string]interface{}{"key": "k2"}},
+	}, entries)
+}
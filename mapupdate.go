@@ -0,0 +1,267 @@
+package FTLogo
+
+/*
+#include "tib/ftl.h"
+*/
+import "C"
+
+import (
+	"fmt"
+	"math"
+	"reflect"
+
+	"github.com/TIBCOSoftware/flogo-lib/core/activity"
+)
+
+// mapUpdate is one read-modify-write step on a field of a map value
+type mapUpdate struct {
+	key    string
+	op     string
+	field  string
+	value  interface{}
+	expect interface{}
+}
+
+// evalMapUpdate applies a batch of field updates while holding the lock named by lockName once:
+// every key is read with GetWithLock, the updates run in input order, and the changed
+// values are written back with SetWithLock before the lock is released
+func evalMapUpdate(context activity.Context) (done bool, err error) {
+	updates, err := inputUpdates(context, "updates")
+	if err != nil {
+		return false, err
+	}
+	name := inputString(context, "lockName")
+	if name == "" {
+		return false, fmt.Errorf("operation [mapUpdate] requires a lockName")
+	}
+	pool, conn, err := getMapPool(context)
+	if err != nil {
+		return false, err
+	}
+	lease, err := getLease(conn, name)
+	if err != nil {
+		return false, err
+	}
+
+	// without a token the batch is its own critical section
+	token, leave, err := enterLease(context, lease)
+	if err != nil {
+		return false, err
+	}
+	defer leave()
+
+	lock, losses, err := lease.use(token)
+	if err != nil {
+		return false, err
+	}
+	results, written, err := pool.update(lock, updates)
+	if err != nil {
+		return false, err
+	}
+	if err := lease.check(token, losses); err != nil {
+		return false, err
+	}
+	if err := publishInvalidation(conn, inputString(context, "endpoint"), inputString(context, "mapName"),
+		inputString(context, "invalidationEndpoint"), written); err != nil {
+		return false, err
+	}
+
+	context.SetOutput("data", results)
+	context.SetOutput("result", fmt.Sprintf("map update applied %d updates to %d keys", len(results), len(written)))
+	return true, nil
+}
+
+// update reads the distinct keys of the batch, applies the updates and writes back the changed values.
+// It returns one result per update and the keys actually written.
+func (pool *mapPool) update(lock C.tibLock, updates []mapUpdate) ([]interface{}, []string, error) {
+	var keys []string
+	values := make(map[string]map[string]interface{})
+	for _, u := range updates {
+		if _, ok := values[u.key]; !ok {
+			values[u.key] = nil
+			keys = append(keys, u.key)
+		}
+	}
+
+	for _, r := range pool.run(mapOpGet, keys, nil, lock) {
+		result := r.(map[string]interface{})
+		if msg, ok := result["error"]; ok {
+			return nil, nil, fmt.Errorf("get of key [%s] failed: %v", result["key"], msg)
+		}
+		value, _ := result["value"].(map[string]interface{})
+		if value == nil {
+			value = make(map[string]interface{})
+		}
+		values[result["key"].(string)] = value
+	}
+
+	results := make([]interface{}, len(updates))
+	changed := make(map[string]bool)
+	var changedKeys []string
+	for i, u := range updates {
+		result, ok, err := applyUpdate(values[u.key], u)
+		if err != nil {
+			return nil, nil, fmt.Errorf("update %d of key [%s]: %v", i, u.key, err)
+		}
+		if ok && !changed[u.key] {
+			changed[u.key] = true
+			changedKeys = append(changedKeys, u.key)
+		}
+		results[i] = result
+	}
+
+	encoded := make([][]byte, len(changedKeys))
+	for i, key := range changedKeys {
+		var err error
+		if encoded[i], err = encodeMessage(nil, values[key]); err != nil {
+			return nil, nil, fmt.Errorf("value of key [%s]: %v", key, err)
+		}
+	}
+
+	var written []string
+	failed := make(map[string]interface{})
+	for i, r := range pool.run(mapOpSet, changedKeys, encoded, lock) {
+		if msg, ok := r.(map[string]interface{})["error"]; ok {
+			failed[changedKeys[i]] = msg
+		} else {
+			written = append(written, changedKeys[i])
+		}
+	}
+	for i, u := range updates {
+		if msg, ok := failed[u.key]; ok {
+			results[i] = map[string]interface{}{"key": u.key, "field": u.field, "error": msg}
+		}
+	}
+	return results, written, nil
+}
+
+// applyUpdate changes one field of value in place, reporting whether the value changed
+func applyUpdate(value map[string]interface{}, u mapUpdate) (result map[string]interface{}, changed bool, err error) {
+	current, exists := value[u.field]
+	result = map[string]interface{}{"key": u.key, "field": u.field, "ok": true}
+
+	switch u.op {
+	case "set":
+		value[u.field] = u.value
+	case "increment":
+		delta := u.value
+		if delta == nil {
+			delta = int64(1)
+		}
+		if !exists {
+			current = int64(0)
+		}
+		if value[u.field], err = addNumbers(current, delta); err != nil {
+			return nil, false, err
+		}
+	case "append":
+		if value[u.field], err = appendValue(current, u.value); err != nil {
+			return nil, false, err
+		}
+	case "compareAndSet":
+		if !sameValue(current, u.expect) {
+			result["ok"] = false
+			result["value"] = current
+			return result, false, nil
+		}
+		value[u.field] = u.value
+	default:
+		return nil, false, fmt.Errorf("unknown update op [%s]", u.op)
+	}
+
+	result["value"] = value[u.field]
+	return result, true, nil
+}
+
+// addNumbers keeps long fields long while the delta is a whole number
+func addNumbers(current, delta interface{}) (interface{}, error) {
+	d, ok := toFloat(delta)
+	if !ok {
+		return nil, fmt.Errorf("increment %v is not a number", delta)
+	}
+	switch c := current.(type) {
+	case int64:
+		if d == math.Trunc(d) {
+			return c + int64(d), nil
+		}
+		return float64(c) + d, nil
+	case float64:
+		return c + d, nil
+	}
+	return nil, fmt.Errorf("field of type %T cannot be incremented", current)
+}
+
+// appendValue concatenates strings, or appends one element or an array of elements to an array
+func appendValue(current, value interface{}) (interface{}, error) {
+	if current == nil {
+		return value, nil
+	}
+	if s, ok := current.(string); ok {
+		v, ok := value.(string)
+		if !ok {
+			return nil, fmt.Errorf("cannot append %T to a string field", value)
+		}
+		return s + v, nil
+	}
+
+	c := reflect.ValueOf(current)
+	if c.Kind() != reflect.Slice || c.Type().Elem().Kind() == reflect.Uint8 {
+		return nil, fmt.Errorf("field of type %T cannot be appended to", current)
+	}
+	elements := make([]interface{}, c.Len(), c.Len()+1)
+	for i := range elements {
+		elements[i] = c.Index(i).Interface()
+	}
+	if more, ok := value.([]interface{}); ok {
+		elements = append(elements, more...)
+	} else {
+		elements = append(elements, value)
+	}
+	return elements, nil
+}
+
+// sameValue compares a stored field with a flow value, treating longs and doubles as numbers
+func sameValue(a, b interface{}) bool {
+	if x, ok := toFloat(a); ok {
+		y, ok := toFloat(b)
+		return ok && x == y
+	}
+	return reflect.DeepEqual(a, b)
+}
+
+func toFloat(v interface{}) (float64, bool) {
+	switch n := v.(type) {
+	case int:
+		return float64(n), true
+	case int64:
+		return float64(n), true
+	case float64:
+		return n, true
+	}
+	return 0, false
+}
+
+// inputUpdates reads an array of {key, op, field, value, expect} objects
+func inputUpdates(context activity.Context, name string) ([]mapUpdate, error) {
+	list, ok := context.GetInput(name).([]interface{})
+	if !ok {
+		return nil, fmt.Errorf("input [%s] must be an array", name)
+	}
+
+	updates := make([]mapUpdate, len(list))
+	for i, item := range list {
+		m, ok := item.(map[string]interface{})
+		if !ok {
+			return nil, fmt.Errorf("input [%s] element %d is not an object", name, i)
+		}
+		u := mapUpdate{value: m["value"], expect: m["expect"]}
+		u.key, _ = m["key"].(string)
+		u.op, _ = m["op"].(string)
+		u.field, _ = m["field"].(string)
+		if u.key == "" || u.field == "" {
+			return nil, fmt.Errorf("input [%s] element %d needs a key and a field", name, i)
+		}
+		updates[i] = u
+	}
+	return updates, nil
+}
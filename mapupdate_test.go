@@ -0,0 +1,42 @@
+package FTLogo
+
+import (
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func TestApplyUpdate(t *testing.T) {
+	value := map[string]interface{}{"count": int64(2), "name": "a", "tags": []string{"x"}}
+
+	result, changed, err := applyUpdate(value, mapUpdate{key: "k", op: "increment", field: "count", value: float64(3)})
+	assert.Nil(t, err)
+	assert.True(t, changed)
+	assert.Equal(t, int64(5), result["value"])
+
+	_, _, err = applyUpdate(value, mapUpdate{key: "k", op: "increment", field: "total"})
+	assert.Nil(t, err)
+	assert.Equal(t, int64(1), value["total"])
+
+	_, _, err = applyUpdate(value, mapUpdate{key: "k", op: "append", field: "name", value: "b"})
+	assert.Nil(t, err)
+	assert.Equal(t, "ab", value["name"])
+
+	_, _, err = applyUpdate(value, mapUpdate{key: "k", op: "append", field: "tags", value: "y"})
+	assert.Nil(t, err)
+	assert.Equal(t, []interface{}{"x", "y"}, value["tags"])
+
+	result, changed, err = applyUpdate(value, mapUpdate{key: "k", op: "compareAndSet", field: "count", expect: float64(4), value: float64(0)})
+	assert.Nil(t, err)
+	assert.False(t, changed)
+	assert.Equal(t, false, result["ok"])
+	assert.Equal(t, int64(5), value["count"])
+
+	_, changed, err = applyUpdate(value, mapUpdate{key: "k", op: "compareAndSet", field: "count", expect: float64(5), value: float64(0)})
+	assert.Nil(t, err)
+	assert.True(t, changed)
+	assert.Equal(t, float64(0), value["count"])
+
+	_, _, err = applyUpdate(value, mapUpdate{key: "k", op: "increment", field: "name"})
+	assert.NotNil(t, err)
+}
@@ -0,0 +1,78 @@
+package FTLogo
+
+/*
+#include <stdlib.h>
+#include "tib/ftl.h"
+*/
+import "C"
+
+import (
+	"bytes"
+	"encoding/json"
+	"fmt"
+	"unsafe"
+)
+
+// contentMatcher returns the realm's matcher for match, creating it on first use.
+// Matchers are kept for the life of the connection and shared by every subscriber whose
+// match string has the same normalized form; an empty match means no matcher.
+func (conn *realmConn) contentMatcher(match string) (C.tibContentMatcher, error) {
+	if match == "" {
+		return nil, nil
+	}
+	normalized, err := normalizeMatcher(match)
+	if err != nil {
+		return nil, err
+	}
+
+	conn.mu.Lock()
+	defer conn.mu.Unlock()
+
+	if err := conn.live(); err != nil {
+		return nil, err
+	}
+	if matcher, ok := conn.matchers[normalized]; ok {
+		return matcher, nil
+	}
+
+	ex := C.tibEx_Create()
+	defer C.tibEx_Destroy(ex)
+
+	cmatch := C.CString(normalized)
+	defer C.free(unsafe.Pointer(cmatch))
+
+	matcher := C.tibContentMatcher_Create(ex, conn.realm, cmatch)
+	if err := exError(ex); err != nil {
+		return nil, fmt.Errorf("invalid matcher %s: %v", match, err)
+	}
+	conn.matchers[normalized] = matcher
+	return matcher, nil
+}
+
+// normalizeMatcher checks that match is a JSON object of field names to strings, longs
+// or booleans (field presence), the forms FTL accepts, and rewrites it with sorted fields
+// and no white space
+func normalizeMatcher(match string) (string, error) {
+	d := json.NewDecoder(bytes.NewReader([]byte(match)))
+	d.UseNumber()
+
+	var fields map[string]interface{}
+	// null decodes into a nil map without error
+	if err := d.Decode(&fields); err != nil || fields == nil || d.More() {
+		return "", fmt.Errorf("matcher %s is not a JSON object", match)
+	}
+	for name, value := range fields {
+		switch v := value.(type) {
+		case string, bool:
+		case json.Number:
+			if _, err := v.Int64(); err != nil {
+				return "", fmt.Errorf("matcher field [%s] must be a long, got %s", name, v)
+			}
+		default:
+			return "", fmt.Errorf("matcher field [%s] must be a string, a long or a boolean", name)
+		}
+	}
+
+	normalized, err := json.Marshal(fields)
+	return string(normalized), err
+}
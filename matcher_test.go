@@ -0,0 +1,21 @@
+package FTLogo
+
+import (
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func TestNormalizeMatcher(t *testing.T) {
+	a, err := normalizeMatcher(`{ "type": "order", "region": 3, "vip": true }`)
+	assert.Nil(t, err)
+	b, err := normalizeMatcher(`{"vip":true,"region":3,"type":"order"}`)
+	assert.Nil(t, err)
+	assert.Equal(t, a, b)
+	assert.Equal(t, `{"region":3,"type":"order","vip":true}`, a)
+
+	for _, bad := range []string{`type=order`, `{"price": 1.5}`, `{"a": {"b": 1}}`, `{"a": 1} {}`, `null`, ` null `} {
+		_, err = normalizeMatcher(bad)
+		assert.NotNil(t, err)
+	}
+}
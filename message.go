@@ -0,0 +1,692 @@
+package FTLogo
+
+/*
+#include <stdlib.h>
+#include <string.h>
+#include "ftlogo.h"
+
+void ftlogoBuf_Put(ftlogoBuf *b, const void *p, int n)
+{
+    if (n > 0 && b->len + n <= b->cap)
+        memcpy(b->data + b->len, p, n);
+    b->len += n;
+}
+
+void ftlogoBuf_PutU32(ftlogoBuf *b, uint32_t v)
+{
+    ftlogoBuf_Put(b, &v, sizeof(v));
+}
+
+void ftlogoBuf_PutString(ftlogoBuf *b, const char *s, int n)
+{
+    if (s == NULL)
+        n = 0;
+    else if (n < 0)
+        n = strlen(s);
+    ftlogoBuf_PutU32(b, n);
+    ftlogoBuf_Put(b, s, n);
+}
+
+static void encodeFields(tibEx ex, tibMessage msg, ftlogoBuf *b)
+{
+    tibMessageIterator  it;
+    tibFieldRef         ref;
+    tibFieldType        type;
+    tibint32_t          size, i;
+    uint8_t             tag;
+
+    it = tibMessageIterator_Create(ex, msg);
+    while (tibEx_GetErrorCode(ex) == TIB_OK && tibMessageIterator_HasNext(ex, it))
+    {
+        ref  = tibMessageIterator_GetNext(ex, it);
+        type = tibMessage_GetFieldTypeByRef(ex, msg, ref);
+        if (type == TIB_FIELD_TYPE_INBOX || type == TIB_FIELD_TYPE_UNKNOWN)
+            continue;
+
+        tag = (uint8_t) type;
+        ftlogoBuf_Put(b, &tag, 1);
+        ftlogoBuf_PutString(b, tibFieldRef_GetFieldName(ex, ref), -1);
+
+        size = 0;
+        switch (type)
+        {
+        case TIB_FIELD_TYPE_LONG:
+        {
+            tibint64_t v = tibMessage_GetLongByRef(ex, msg, ref);
+            ftlogoBuf_Put(b, &v, sizeof(v));
+            break;
+        }
+        case TIB_FIELD_TYPE_DOUBLE:
+        {
+            tibdouble_t v = tibMessage_GetDoubleByRef(ex, msg, ref);
+            ftlogoBuf_Put(b, &v, sizeof(v));
+            break;
+        }
+        case TIB_FIELD_TYPE_STRING:
+            ftlogoBuf_PutString(b, tibMessage_GetStringByRef(ex, msg, ref), -1);
+            break;
+        case TIB_FIELD_TYPE_OPAQUE:
+        {
+            const void *p = tibMessage_GetOpaqueByRef(ex, msg, ref, &size);
+            ftlogoBuf_PutString(b, p, p ? size : 0);
+            break;
+        }
+        case TIB_FIELD_TYPE_DATETIME:
+        {
+            tibDateTime zero = {0, 0};
+            tibDateTime *dt = tibMessage_GetDateTimeByRef(ex, msg, ref);
+            ftlogoBuf_Put(b, dt ? dt : &zero, sizeof(tibDateTime));
+            break;
+        }
+        case TIB_FIELD_TYPE_LONG_ARRAY:
+        case TIB_FIELD_TYPE_DOUBLE_ARRAY:
+        case TIB_FIELD_TYPE_DATETIME_ARRAY:
+        {
+            int width = type == TIB_FIELD_TYPE_DATETIME_ARRAY ? sizeof(tibDateTime) : 8;
+            const void *a = tibMessage_GetArrayByRef(ex, msg, type, ref, &size);
+            ftlogoBuf_PutU32(b, a ? size : 0);
+            ftlogoBuf_Put(b, a, a ? size * width : 0);
+            break;
+        }
+        case TIB_FIELD_TYPE_STRING_ARRAY:
+        {
+            const char **a = tibMessage_GetArrayByRef(ex, msg, type, ref, &size);
+            if (a == NULL)
+                size = 0;
+            ftlogoBuf_PutU32(b, size);
+            for (i = 0; i < size; i++)
+                ftlogoBuf_PutString(b, a[i], -1);
+            break;
+        }
+        case TIB_FIELD_TYPE_MESSAGE:
+            ftlogoMessage_Encode(ex, tibMessage_GetMessageByRef(ex, msg, ref), b);
+            break;
+        case TIB_FIELD_TYPE_MESSAGE_ARRAY:
+        {
+            tibMessage *a = tibMessage_GetArrayByRef(ex, msg, type, ref, &size);
+            if (a == NULL)
+                size = 0;
+            ftlogoBuf_PutU32(b, size);
+            for (i = 0; i < size; i++)
+                ftlogoMessage_Encode(ex, a[i], b);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    tibMessageIterator_Destroy(ex, it);
+}
+
+// Appends the fields of msg to b, prefixed with their encoded length
+void ftlogoMessage_Encode(tibEx ex, tibMessage msg, ftlogoBuf *b)
+{
+    int start = b->len;
+
+    ftlogoBuf_PutU32(b, 0);
+    if (msg != NULL)
+        encodeFields(ex, msg, b);
+    if (start + 4 <= b->cap)
+    {
+        uint32_t n = b->len - start - 4;
+        memcpy(b->data + start, &n, sizeof(n));
+    }
+}
+static int readOk(ftlogoReader *r, int n)
+{
+    if (n < 0 || r->pos + n > r->len)
+    {
+        r->pos = r->len + 1;
+        return 0;
+    }
+    return 1;
+}
+
+static void readInto(ftlogoReader *r, void *p, int n)
+{
+    if (readOk(r, n))
+    {
+        memcpy(p, r->data + r->pos, n);
+        r->pos += n;
+    }
+    else
+        memset(p, 0, n);
+}
+
+static uint32_t readU32(ftlogoReader *r)
+{
+    uint32_t v;
+    readInto(r, &v, sizeof(v));
+    return v;
+}
+
+static const char *readBytes(ftlogoReader *r, int *n)
+{
+    const char *p;
+
+    *n = readU32(r);
+    if (!readOk(r, *n))
+    {
+        *n = 0;
+        return NULL;
+    }
+    p = r->data + r->pos;
+    r->pos += *n;
+    return p;
+}
+
+// Returns a NUL terminated copy of the next string, to be released with free
+static char *readString(ftlogoReader *r)
+{
+    int         n;
+    const char  *p = readBytes(r, &n);
+    char        *s = malloc(n + 1);
+
+    if (p != NULL)
+        memcpy(s, p, n);
+    s[n] = '\0';
+    return s;
+}
+
+static tibMessage decodeNested(tibEx ex, tibRealm realm, ftlogoReader *r);
+
+static void decodeFields(tibEx ex, tibRealm realm, tibMessage msg, ftlogoReader *r)
+{
+    uint8_t     tag;
+    char        *name;
+    uint32_t    i, n;
+
+    while (r->pos < r->len && tibEx_GetErrorCode(ex) == TIB_OK)
+    {
+        readInto(r, &tag, 1);
+        name = readString(r);
+
+        switch (tag)
+        {
+        case TIB_FIELD_TYPE_LONG:
+        {
+            tibint64_t v;
+            readInto(r, &v, sizeof(v));
+            tibMessage_SetLong(ex, msg, name, v);
+            break;
+        }
+        case TIB_FIELD_TYPE_DOUBLE:
+        {
+            tibdouble_t v;
+            readInto(r, &v, sizeof(v));
+            tibMessage_SetDouble(ex, msg, name, v);
+            break;
+        }
+        case TIB_FIELD_TYPE_STRING:
+        {
+            char *v = readString(r);
+            tibMessage_SetString(ex, msg, name, v);
+            free(v);
+            break;
+        }
+        case TIB_FIELD_TYPE_OPAQUE:
+        {
+            int         size;
+            const char  *v = readBytes(r, &size);
+            tibMessage_SetOpaque(ex, msg, name, v, size);
+            break;
+        }
+        case TIB_FIELD_TYPE_DATETIME:
+        {
+            tibDateTime v;
+            readInto(r, &v, sizeof(v));
+            tibMessage_SetDateTime(ex, msg, name, &v);
+            break;
+        }
+        case TIB_FIELD_TYPE_LONG_ARRAY:
+        case TIB_FIELD_TYPE_DOUBLE_ARRAY:
+        case TIB_FIELD_TYPE_DATETIME_ARRAY:
+        {
+            int     width = tag == TIB_FIELD_TYPE_DATETIME_ARRAY ? sizeof(tibDateTime) : 8;
+            void    *a;
+
+            n = readU32(r);
+            if (n > (uint32_t) r->len || !readOk(r, n * width))
+                break;
+            a = malloc(n * width + 1);
+            readInto(r, a, n * width);
+            tibMessage_SetArray(ex, msg, tag, name, a, n);
+            free(a);
+            break;
+        }
+        case TIB_FIELD_TYPE_STRING_ARRAY:
+        {
+            char **a;
+
+            n = readU32(r);
+            if (n > (uint32_t) r->len || !readOk(r, n * 4))
+                break;
+            a = calloc(n + 1, sizeof(char *));
+            for (i = 0; i < n; i++)
+                a[i] = readString(r);
+            tibMessage_SetArray(ex, msg, tag, name, a, n);
+            for (i = 0; i < n; i++)
+                free(a[i]);
+            free(a);
+            break;
+        }
+        case TIB_FIELD_TYPE_MESSAGE:
+        {
+            tibMessage v = decodeNested(ex, realm, r);
+            tibMessage_SetMessage(ex, msg, name, v);
+            tibMessage_Destroy(ex, v);
+            break;
+        }
+        case TIB_FIELD_TYPE_MESSAGE_ARRAY:
+        {
+            tibMessage *a;
+
+            n = readU32(r);
+            if (n > (uint32_t) r->len || !readOk(r, n * 4))
+                break;
+            a = calloc(n + 1, sizeof(tibMessage));
+            for (i = 0; i < n; i++)
+                a[i] = decodeNested(ex, realm, r);
+            tibMessage_SetArray(ex, msg, tag, name, a, n);
+            for (i = 0; i < n; i++)
+                tibMessage_Destroy(ex, a[i]);
+            free(a);
+            break;
+        }
+        default:
+            r->pos = r->len + 1;
+            break;
+        }
+        free(name);
+    }
+}
+
+static tibMessage decodeNested(tibEx ex, tibRealm realm, ftlogoReader *r)
+{
+    ftlogoReader    sub;
+    tibMessage      msg;
+
+    sub.data = readBytes(r, &sub.len);
+    sub.pos = 0;
+    msg = tibMessage_Create(ex, realm, NULL);
+    decodeFields(ex, realm, msg, &sub);
+    if (sub.pos > sub.len)
+        r->pos = r->len + 1;
+    return msg;
+}
+
+// Creates a message from one length-prefixed encoding written by encodeMessage.
+// Sets *bad and returns NULL when the encoding is malformed.
+tibMessage ftlogoMessage_Decode(tibEx ex, tibRealm realm, ftlogoReader *r, int *bad)
+{
+    tibMessage msg = decodeNested(ex, realm, r);
+
+    *bad = r->pos > r->len;
+    if (*bad || tibEx_GetErrorCode(ex) != TIB_OK)
+    {
+        tibMessage_Destroy(ex, msg);
+        return NULL;
+    }
+    return msg;
+}
+*/
+import "C"
+
+import (
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"math"
+	"time"
+)
+
+// Field type tags written by ftlogoMessage_Encode, matching tibFieldType
+const (
+	fieldOpaque        = 0
+	fieldLong          = 1
+	fieldLongArray     = 2
+	fieldDouble        = 3
+	fieldDoubleArray   = 4
+	fieldString        = 5
+	fieldStringArray   = 6
+	fieldMessage       = 7
+	fieldMessageArray  = 8
+	fieldDateTime      = 10
+	fieldDateTimeArray = 11
+)
+
+var errTruncated = errors.New("truncated message encoding")
+
+// fieldReader walks the little endian encoding produced by ftlogoMessage_Encode
+type fieldReader struct {
+	data []byte
+	pos  int
+	err  error
+}
+
+func (r *fieldReader) next(n int) []byte {
+	if r.err != nil {
+		return nil
+	}
+	if n < 0 || r.pos+n > len(r.data) {
+		r.err = errTruncated
+		return nil
+	}
+	b := r.data[r.pos : r.pos+n]
+	r.pos += n
+	return b
+}
+
+func (r *fieldReader) u8() byte {
+	if b := r.next(1); b != nil {
+		return b[0]
+	}
+	return 0
+}
+
+func (r *fieldReader) u32() int {
+	if b := r.next(4); b != nil {
+		return int(binary.LittleEndian.Uint32(b))
+	}
+	return 0
+}
+
+// count reads an array length, rejecting lengths the remaining input cannot hold
+func (r *fieldReader) count(width int) int {
+	n := r.u32()
+	if r.err == nil && n*width > len(r.data)-r.pos {
+		r.err = errTruncated
+		return 0
+	}
+	return n
+}
+
+func (r *fieldReader) i64() int64 {
+	if b := r.next(8); b != nil {
+		return int64(binary.LittleEndian.Uint64(b))
+	}
+	return 0
+}
+
+func (r *fieldReader) f64() float64 {
+	if b := r.next(8); b != nil {
+		return math.Float64frombits(binary.LittleEndian.Uint64(b))
+	}
+	return 0
+}
+
+func (r *fieldReader) bytes() []byte {
+	return r.next(r.u32())
+}
+
+func (r *fieldReader) str() string {
+	return string(r.bytes())
+}
+
+func (r *fieldReader) dateTime() time.Time {
+	sec := r.i64()
+	nsec := r.i64()
+	return time.Unix(sec, nsec)
+}
+
+// message reads one length-prefixed message
+func (r *fieldReader) message() map[string]interface{} {
+	body := r.bytes()
+	if r.err != nil {
+		return nil
+	}
+	fields, err := decodeFields(body)
+	if err != nil {
+		r.err = err
+	}
+	return fields
+}
+
+// decodeMessage converts one length-prefixed message encoding into flow data
+func decodeMessage(data []byte) (map[string]interface{}, error) {
+	r := &fieldReader{data: data}
+	fields := r.message()
+	return fields, r.err
+}
+
+func decodeFields(data []byte) (map[string]interface{}, error) {
+	r := &fieldReader{data: data}
+	fields := make(map[string]interface{})
+
+	for r.err == nil && r.pos < len(r.data) {
+		tag := r.u8()
+		name := r.str()
+
+		var value interface{}
+		switch tag {
+		case fieldLong:
+			value = r.i64()
+		case fieldDouble:
+			value = r.f64()
+		case fieldString:
+			value = r.str()
+		case fieldOpaque:
+			value = append([]byte(nil), r.bytes()...)
+		case fieldDateTime:
+			value = r.dateTime()
+		case fieldLongArray:
+			a := make([]int64, r.count(8))
+			for i := range a {
+				a[i] = r.i64()
+			}
+			value = a
+		case fieldDoubleArray:
+			a := make([]float64, r.count(8))
+			for i := range a {
+				a[i] = r.f64()
+			}
+			value = a
+		case fieldDateTimeArray:
+			a := make([]time.Time, r.count(16))
+			for i := range a {
+				a[i] = r.dateTime()
+			}
+			value = a
+		case fieldStringArray:
+			a := make([]string, r.count(4))
+			for i := range a {
+				a[i] = r.str()
+			}
+			value = a
+		case fieldMessage:
+			value = r.message()
+		case fieldMessageArray:
+			a := make([]map[string]interface{}, r.count(4))
+			for i := range a {
+				a[i] = r.message()
+			}
+			value = a
+		default:
+			return nil, errors.New("unknown field type in message encoding")
+		}
+		fields[name] = value
+	}
+	return fields, r.err
+}
+
+// fieldWriter produces the little endian encoding read by ftlogoMessage_Decode
+type fieldWriter struct {
+	buf []byte
+}
+
+func (w *fieldWriter) u32(v int) {
+	var b [4]byte
+	binary.LittleEndian.PutUint32(b[:], uint32(v))
+	w.buf = append(w.buf, b[:]...)
+}
+
+func (w *fieldWriter) i64(v int64) {
+	var b [8]byte
+	binary.LittleEndian.PutUint64(b[:], uint64(v))
+	w.buf = append(w.buf, b[:]...)
+}
+
+func (w *fieldWriter) f64(v float64) {
+	w.i64(int64(math.Float64bits(v)))
+}
+
+func (w *fieldWriter) str(s string) {
+	w.u32(len(s))
+	w.buf = append(w.buf, s...)
+}
+
+func (w *fieldWriter) dateTime(t time.Time) {
+	w.i64(t.Unix())
+	w.i64(int64(t.Nanosecond()))
+}
+
+func (w *fieldWriter) field(tag byte, name string) {
+	w.buf = append(w.buf, tag)
+	w.str(name)
+}
+
+// message writes fields as one length-prefixed message
+func (w *fieldWriter) message(fields map[string]interface{}) error {
+	start := len(w.buf)
+	w.u32(0)
+	for name, value := range fields {
+		if err := w.value(name, value); err != nil {
+			return err
+		}
+	}
+	binary.LittleEndian.PutUint32(w.buf[start:], uint32(len(w.buf)-start-4))
+	return nil
+}
+
+// value writes one flow value as the closest FTL field type.
+// Whole numbers become longs since flow data carries JSON numbers as float64.
+func (w *fieldWriter) value(name string, value interface{}) error {
+	switch v := value.(type) {
+	case nil:
+	case string:
+		w.field(fieldString, name)
+		w.str(v)
+	case bool:
+		w.field(fieldLong, name)
+		if v {
+			w.i64(1)
+		} else {
+			w.i64(0)
+		}
+	case int:
+		w.field(fieldLong, name)
+		w.i64(int64(v))
+	case int32:
+		w.field(fieldLong, name)
+		w.i64(int64(v))
+	case int64:
+		w.field(fieldLong, name)
+		w.i64(v)
+	case float64:
+		if v == math.Trunc(v) && math.Abs(v) < 1<<53 {
+			w.field(fieldLong, name)
+			w.i64(int64(v))
+		} else {
+			w.field(fieldDouble, name)
+			w.f64(v)
+		}
+	case []byte:
+		w.field(fieldOpaque, name)
+		w.u32(len(v))
+		w.buf = append(w.buf, v...)
+	case time.Time:
+		w.field(fieldDateTime, name)
+		w.dateTime(v)
+	case map[string]interface{}:
+		w.field(fieldMessage, name)
+		return w.message(v)
+	case []string:
+		w.field(fieldStringArray, name)
+		w.u32(len(v))
+		for _, s := range v {
+			w.str(s)
+		}
+	case []int64:
+		w.field(fieldLongArray, name)
+		w.u32(len(v))
+		for _, n := range v {
+			w.i64(n)
+		}
+	case []float64:
+		w.field(fieldDoubleArray, name)
+		w.u32(len(v))
+		for _, f := range v {
+			w.f64(f)
+		}
+	case []time.Time:
+		w.field(fieldDateTimeArray, name)
+		w.u32(len(v))
+		for _, t := range v {
+			w.dateTime(t)
+		}
+	case []map[string]interface{}:
+		w.field(fieldMessageArray, name)
+		w.u32(len(v))
+		for _, m := range v {
+			if err := w.message(m); err != nil {
+				return err
+			}
+		}
+	case []interface{}:
+		return w.array(name, v)
+	default:
+		return fmt.Errorf("field [%s] has unsupported type %T", name, value)
+	}
+	return nil
+}
+
+// array writes a generic flow array, typed after its elements
+func (w *fieldWriter) array(name string, values []interface{}) error {
+	var (
+		strings  []string
+		numbers  []float64
+		messages []map[string]interface{}
+		whole    = true
+	)
+	for _, value := range values {
+		switch v := value.(type) {
+		case string:
+			strings = append(strings, v)
+		case float64:
+			numbers = append(numbers, v)
+			whole = whole && v == math.Trunc(v)
+		case int:
+			numbers = append(numbers, float64(v))
+		case int64:
+			numbers = append(numbers, float64(v))
+		case map[string]interface{}:
+			messages = append(messages, v)
+		default:
+			return fmt.Errorf("field [%s] has unsupported array element type %T", name, value)
+		}
+	}
+
+	switch len(values) {
+	case len(strings):
+		return w.value(name, strings)
+	case len(messages):
+		return w.value(name, messages)
+	case len(numbers):
+		if !whole {
+			return w.value(name, numbers)
+		}
+		longs := make([]int64, len(numbers))
+		for i, f := range numbers {
+			longs[i] = int64(f)
+		}
+		return w.value(name, longs)
+	}
+	return fmt.Errorf("field [%s] mixes element types", name)
+}
+
+// encodeMessage appends the length-prefixed encoding of fields to buf
+func encodeMessage(buf []byte, fields map[string]interface{}) ([]byte, error) {
+	w := &fieldWriter{buf: buf}
+	err := w.message(fields)
+	return w.buf, err
+}
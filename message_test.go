@@ -0,0 +1,106 @@
+package FTLogo
+
+import (
+	"bytes"
+	"encoding/binary"
+	"math"
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+)
+
+// encodingBuilder writes the layout produced by ftlogoMessage_Encode
+type encodingBuilder struct {
+	bytes.Buffer
+}
+
+func (b *encodingBuilder) u32(v int) {
+	binary.Write(b, binary.LittleEndian, uint32(v))
+}
+
+func (b *encodingBuilder) str(s string) {
+	b.u32(len(s))
+	b.WriteString(s)
+}
+
+func (b *encodingBuilder) field(tag byte, name string) {
+	b.WriteByte(tag)
+	b.str(name)
+}
+
+func (b *encodingBuilder) message(fields func(*encodingBuilder)) {
+	inner := &encodingBuilder{}
+	fields(inner)
+	b.u32(inner.Len())
+	b.Write(inner.Bytes())
+}
+
+func TestDecodeMessage(t *testing.T) {
+	b := &encodingBuilder{}
+	b.message(func(m *encodingBuilder) {
+		m.field(fieldString, "type")
+		m.str("hello")
+		m.field(fieldLong, "count")
+		binary.Write(m, binary.LittleEndian, int64(-42))
+		m.field(fieldDouble, "price")
+		binary.Write(m, binary.LittleEndian, math.Float64bits(1.5))
+		m.field(fieldStringArray, "tags")
+		m.u32(2)
+		m.str("a")
+		m.str("b")
+		m.field(fieldMessage, "inner")
+		m.message(func(n *encodingBuilder) {
+			n.field(fieldOpaque, "data")
+			n.str("xyz")
+		})
+	})
+
+	fields, err := decodeMessage(b.Bytes())
+	assert.Nil(t, err)
+	assert.Equal(t, "hello", fields["type"])
+	assert.Equal(t, int64(-42), fields["count"])
+	assert.Equal(t, 1.5, fields["price"])
+	assert.Equal(t, []string{"a", "b"}, fields["tags"])
+	assert.Equal(t, map[string]interface{}{"data": []byte("xyz")}, fields["inner"])
+}
+
+func TestDecodeMessageTruncated(t *testing.T) {
+	b := &encodingBuilder{}
+	b.message(func(m *encodingBuilder) {
+		m.field(fieldLongArray, "values")
+		m.u32(1000)
+	})
+
+	_, err := decodeMessage(b.Bytes())
+	assert.Equal(t, errTruncated, err)
+}
+
+func TestEncodeMessageRoundTrip(t *testing.T) {
+	fields := map[string]interface{}{
+		"type":   "hello",
+		"count":  float64(3),
+		"price":  2.25,
+		"tags":   []interface{}{"x", "y"},
+		"values": []interface{}{float64(1), float64(2)},
+		"inner":  map[string]interface{}{"flag": true},
+	}
+
+	data, err := encodeMessage(nil, fields)
+	assert.Nil(t, err)
+
+	decoded, err := decodeMessage(data)
+	assert.Nil(t, err)
+	assert.Equal(t, map[string]interface{}{
+		"type":   "hello",
+		"count":  int64(3),
+		"price":  2.25,
+		"tags":   []string{"x", "y"},
+		"values": []int64{1, 2},
+		"inner":  map[string]interface{}{"flag": int64(1)},
+	}, decoded)
+}
+
+func TestEncodeMessageUnsupported(t *testing.T) {
+	_, err := encodeMessage(nil, map[string]interface{}{"bad": struct{}{}})
+	assert.NotNil(t, err)
+}
@@ -0,0 +1,205 @@
+package FTLogo
+
+import (
+	"fmt"
+	"os"
+	"sync"
+	"time"
+)
+
+// tombstoneRetention bounds how long an invalidation is remembered; a fill that
+// started before an invalidation which has since been forgotten is discarded
+const tombstoneRetention = time.Minute
+
+// cacheEntry is a cached value, or a tombstone. Every entry carries the latest invalidation
+// of its key and the sequence its value was read at, so no older fill can replace it.
+type cacheEntry struct {
+	value       map[string]interface{}
+	read        time.Time
+	expires     time.Time
+	invalidated uint64
+	filled      uint64
+}
+
+// nearCache keeps map values in process until they expire or another writer invalidates them.
+// Every invalidation takes a new sequence number; a fill only installs its value when no
+// invalidation of the key is newer than the sequence observed before the map was read.
+//
+// Every reader of a map shares its cache, so each lookup applies the reader's own ttl to the
+// age of the value; values are kept for the longest ttl asked for. The cache listens on every
+// invalidation endpoint any of its readers named.
+type nearCache struct {
+	name string
+	conn *realmConn
+	subs map[string]*subscription
+	stop chan struct{}
+
+	mu        sync.Mutex
+	ttl       time.Duration
+	entries   map[string]*cacheEntry
+	seq       uint64
+	forgotten uint64
+}
+
+// invalidationOrigin identifies this process in the invalidations it publishes
+var invalidationOrigin = fmt.Sprintf("%d-%d", os.Getpid(), time.Now().UnixNano())
+
+var (
+	nearCachesMu sync.Mutex
+	nearCaches   = make(map[string]*nearCache)
+)
+
+// getNearCache returns the near cache of a map, subscribing to its invalidations when an endpoint is given
+func getNearCache(conn *realmConn, endpoint, mapName string, ttl time.Duration, invalidationEndpoint string) (*nearCache, error) {
+	name := endpoint + "/" + mapName
+	key := conn.url + "|" + name
+
+	nearCachesMu.Lock()
+	defer nearCachesMu.Unlock()
+
+	cache, ok := nearCaches[key]
+	if !ok {
+		cache = &nearCache{name: name, conn: conn, subs: make(map[string]*subscription), stop: make(chan struct{}), entries: make(map[string]*cacheEntry)}
+	}
+	if _, subscribed := cache.subs[invalidationEndpoint]; invalidationEndpoint != "" && !subscribed {
+		queue, err := conn.sharedQueue()
+		if err != nil {
+			return nil, err
+		}
+		sub, err := queue.subscribe(subscriberConfig{endpoint: invalidationEndpoint}, cache.onInvalidations)
+		if err != nil {
+			return nil, err
+		}
+		cache.subs[invalidationEndpoint] = sub
+	}
+
+	cache.mu.Lock()
+	if ttl > cache.ttl {
+		cache.ttl = ttl
+	}
+	cache.mu.Unlock()
+
+	if !ok {
+		go cache.sweep()
+		nearCaches[key] = cache
+	}
+	return cache, nil
+}
+
+// findNearCache returns the near cache of a map if one was created
+func findNearCache(conn *realmConn, endpoint, mapName string) *nearCache {
+	nearCachesMu.Lock()
+	defer nearCachesMu.Unlock()
+	return nearCaches[conn.url+"|"+endpoint+"/"+mapName]
+}
+
+// retireNearCaches drops the near caches of conn: invalidations published while it was
+// disabled were missed, so none of their values can be trusted
+func retireNearCaches(conn *realmConn) {
+	nearCachesMu.Lock()
+	defer nearCachesMu.Unlock()
+
+	for key, cache := range nearCaches {
+		if cache.conn == conn {
+			delete(nearCaches, key)
+			for _, sub := range cache.subs {
+				sub.close()
+			}
+			close(cache.stop)
+		}
+	}
+}
+
+// lookup returns the cached value of key if it was read within ttl, or the sequence a later fill must present
+func (c *nearCache) lookup(key string, ttl time.Duration) (value map[string]interface{}, seq uint64, hit bool) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+
+	if e, ok := c.entries[key]; ok && e.value != nil && time.Since(e.read) < ttl {
+		return e.value, 0, true
+	}
+	return nil, c.seq, false
+}
+
+// fill caches a value read from the map unless the key was invalidated after seq
+func (c *nearCache) fill(key string, value map[string]interface{}, seq uint64) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+
+	if seq < c.forgotten {
+		return
+	}
+	var invalidated uint64
+	if e, ok := c.entries[key]; ok {
+		if e.invalidated > seq || (e.value != nil && e.filled > seq) {
+			return
+		}
+		invalidated = e.invalidated
+	}
+	now := time.Now()
+	c.entries[key] = &cacheEntry{value: value, read: now, expires: now.Add(c.ttl), invalidated: invalidated, filled: seq}
+}
+
+// invalidate drops keys and leaves tombstones so in-flight fills cannot repopulate them
+func (c *nearCache) invalidate(keys []string) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+
+	c.seq++
+	expires := time.Now().Add(tombstoneRetention)
+	for _, key := range keys {
+		c.entries[key] = &cacheEntry{expires: expires, invalidated: c.seq}
+	}
+}
+
+func (c *nearCache) onInvalidations(msgs []*inboundMessage) {
+	for _, m := range msgs {
+		if m.fields["map"] != c.name || m.fields["origin"] == invalidationOrigin {
+			continue
+		}
+		if keys, ok := m.fields["keys"].([]string); ok {
+			c.invalidate(keys)
+		}
+	}
+}
+
+// sweep periodically removes expired values and tombstones
+func (c *nearCache) sweep() {
+	ticker := time.NewTicker(tombstoneRetention / 2)
+	defer ticker.Stop()
+
+	for {
+		select {
+		case <-ticker.C:
+		case <-c.stop:
+			return
+		}
+		now := time.Now()
+		c.mu.Lock()
+		for key, e := range c.entries {
+			if now.After(e.expires) {
+				if e.invalidated > c.forgotten {
+					c.forgotten = e.invalidated
+				}
+				delete(c.entries, key)
+			}
+		}
+		c.mu.Unlock()
+	}
+}
+
+// publishInvalidation evicts keys from the local near cache and tells other readers to do the same
+func publishInvalidation(conn *realmConn, endpoint, mapName, invalidationEndpoint string, keys []string) error {
+	if cache := findNearCache(conn, endpoint, mapName); cache != nil {
+		cache.invalidate(keys)
+	}
+	if invalidationEndpoint == "" || len(keys) == 0 {
+		return nil
+	}
+
+	return publishFields(conn, invalidationEndpoint, map[string]interface{}{
+		"map":    endpoint + "/" + mapName,
+		"keys":   keys,
+		"origin": invalidationOrigin,
+	})
+}
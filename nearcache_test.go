@@ -0,0 +1,90 @@
+package FTLogo
+
+import (
+	"testing"
+	"time"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func newTestNearCache() *nearCache {
+	return &nearCache{name: "ep/m", ttl: time.Minute, entries: make(map[string]*cacheEntry)}
+}
+
+func TestNearCacheFill(t *testing.T) {
+	c := newTestNearCache()
+
+	_, seq, hit := c.lookup("a", time.Minute)
+	assert.False(t, hit)
+
+	c.fill("a", map[string]interface{}{"n": int64(1)}, seq)
+	value, _, hit := c.lookup("a", time.Minute)
+	assert.True(t, hit)
+	assert.Equal(t, int64(1), value["n"])
+
+	c.invalidate([]string{"a"})
+	_, _, hit = c.lookup("a", time.Minute)
+	assert.False(t, hit)
+}
+
+func TestNearCacheStaleFill(t *testing.T) {
+	c := newTestNearCache()
+
+	// a read that started before the invalidation must not repopulate the key
+	_, seq, _ := c.lookup("a", time.Minute)
+	c.invalidate([]string{"a"})
+	c.fill("a", map[string]interface{}{"n": int64(1)}, seq)
+	_, _, hit := c.lookup("a", time.Minute)
+	assert.False(t, hit)
+
+	// a read that started after it may
+	_, seq, _ = c.lookup("a", time.Minute)
+	c.fill("a", map[string]interface{}{"n": int64(2)}, seq)
+	value, _, hit := c.lookup("a", time.Minute)
+	assert.True(t, hit)
+	assert.Equal(t, int64(2), value["n"])
+
+	// a fill read before the invalidation but landing after a newer fill is still refused
+	c.invalidate([]string{"a"})
+	_, seq, _ = c.lookup("a", time.Minute)
+	c.fill("a", map[string]interface{}{"n": int64(4)}, seq)
+	c.fill("a", map[string]interface{}{"n": int64(1)}, seq-1)
+	value, _, hit = c.lookup("a", time.Minute)
+	assert.True(t, hit)
+	assert.Equal(t, int64(4), value["n"])
+
+	// once the tombstone is forgotten, fills older than it are refused outright
+	c.forgotten = c.seq + 1
+	c.fill("b", map[string]interface{}{"n": int64(3)}, seq)
+	_, _, hit = c.lookup("b", time.Minute)
+	assert.False(t, hit)
+}
+
+func TestNearCacheOnInvalidations(t *testing.T) {
+	c := newTestNearCache()
+	c.fill("a", map[string]interface{}{}, 0)
+	c.fill("b", map[string]interface{}{}, 0)
+
+	c.onInvalidations([]*inboundMessage{
+		{fields: map[string]interface{}{"map": "ep/other", "keys": []string{"b"}, "origin": "x"}},
+		{fields: map[string]interface{}{"map": "ep/m", "keys": []string{"b"}, "origin": invalidationOrigin}},
+		{fields: map[string]interface{}{"map": "ep/m", "keys": []string{"a"}, "origin": "x"}},
+	})
+
+	_, _, hit := c.lookup("a", time.Minute)
+	assert.False(t, hit)
+	_, _, hit = c.lookup("b", time.Minute)
+	assert.True(t, hit)
+}
+
+func TestNearCacheReaderTTL(t *testing.T) {
+	c := newTestNearCache()
+	c.fill("a", map[string]interface{}{}, 0)
+	c.entries["a"].read = time.Now().Add(-2 * time.Second)
+
+	// readers sharing the cache each apply their own ttl to the same value
+	_, _, hit := c.lookup("a", time.Second)
+	assert.False(t, hit)
+	_, _, hit = c.lookup("a", time.Minute)
+	assert.True(t, hit)
+}
@@ -0,0 +1,240 @@
+package FTLogo
+
+/*
+#include <stdlib.h>
+#include "tib/ftl.h"
+*/
+import "C"
+
+import (
+	"fmt"
+	"sync"
+	"time"
+	"unsafe"
+
+	"github.com/TIBCOSoftware/flogo-lib/core/activity"
+)
+
+// publisher returns the publisher of this realm for endpoint, creating it on first use
+func (conn *realmConn) publisher(endpoint string) (C.tibPublisher, error) {
+	conn.mu.Lock()
+	defer conn.mu.Unlock()
+
+	if err := conn.live(); err != nil {
+		return nil, err
+	}
+	if pub, ok := conn.publishers[endpoint]; ok {
+		return pub, nil
+	}
+
+	ex := C.tibEx_Create()
+	defer C.tibEx_Destroy(ex)
+
+	cendpoint := cStringOrNil(endpoint)
+	defer C.free(unsafe.Pointer(cendpoint))
+
+	pub := C.tibPublisher_Create(ex, conn.realm, cendpoint, nil)
+	if err := exError(ex); err != nil {
+		return nil, err
+	}
+	conn.publishers[endpoint] = pub
+	return pub, nil
+}
+
+// publishFields sends one message built from flow data through the pooled publisher for endpoint
+func publishFields(conn *realmConn, endpoint string, fields map[string]interface{}) error {
+	data, err := encodeMessage(nil, fields)
+	if err != nil {
+		return err
+	}
+	return publishEncoded(conn, endpoint, data)
+}
+
+// publishEncoded sends one message from its encoding through the pooled publisher for
+// endpoint, on the sender thread that owns it, once the rate limits allow it
+func publishEncoded(conn *realmConn, endpoint string, data []byte) error {
+	takeRate(conn.url, endpoint, 1)
+	return sendOnWorker(conn, endpoint, data)
+}
+
+// sendFunc sends fields to endpoint, reporting whether they actually went out
+type sendFunc func(endpoint string, fields map[string]interface{}) (bool, error)
+
+// evalPooledSend sends the message through the pooled connection of url
+func evalPooledSend(context activity.Context, url, message string) (done bool, err error) {
+	result, err := pooledSend(context, url, message)
+	if err != nil {
+		return false, err
+	}
+	context.SetOutput("result", result)
+	return true, nil
+}
+
+// pooledSend compresses the message when compression is set and sends it through the
+// pooled connection of url: through the lane of its priority when one is set, queued to the
+// endpoint's sender thread when async is set, only from the active member when a singleton
+// group is set and conflated per key when a conflation interval is set. The layers compose:
+// the group decides whether the message goes out, then it goes through its lane or the
+// async sender, and a failed send goes to the spool. Priority lanes and async send cannot
+// be combined. It describes what became of the message.
+func pooledSend(context activity.Context, url, message string) (result string, err error) {
+	endpoint := inputString(context, "endpoint")
+	fields := map[string]interface{}{"type": "hello", "message": message}
+	if mode := inputString(context, "compression"); mode != "" {
+		if err := compressFields(fields, mode, inputInt(context, "compressionThreshold", 0)); err != nil {
+			return "", err
+		}
+	}
+
+	var sp *spool
+	if dir := inputString(context, "spoolDir"); dir != "" {
+		if sp, err = getSpool(dir, url, int64(inputInt(context, "spoolMaxMB", 0))<<20); err != nil {
+			return "", err
+		}
+		// keep the order: nothing overtakes messages still waiting in the spool
+		if sp.pending() {
+			return spoolSend(sp, endpoint, fields)
+		}
+	}
+
+	conn, err := getRealm(url)
+	if err != nil {
+		if sp == nil {
+			return "", err
+		}
+		log.Warnf("Realm [%s] unreachable, spooling: %v", url, err)
+		return spoolSend(sp, endpoint, fields)
+	}
+
+	// the limiters are registered here and taken where messages are finally published:
+	// publishEncoded, the lanes and the async sender
+	rateLimiter(endpointLimiterKey(url, endpoint), inputInt(context, "rateLimit", 0), inputInt(context, "rateBurst", 0))
+	rateLimiter(realmLimiterKey(url), inputInt(context, "realmRateLimit", 0), inputInt(context, "realmRateBurst", 0))
+
+	priority := inputString(context, "priority")
+	async, _ := context.GetInput("async").(bool)
+	if priority != "" && async {
+		return "", fmt.Errorf("priority [%s] of endpoint [%s] cannot be combined with async send", priority, endpoint)
+	}
+
+	publish := func(endpoint string, fields map[string]interface{}) error {
+		return publishFields(conn, endpoint, fields)
+	}
+	if priority != "" {
+		i, err := laneIndex(priority)
+		if err != nil {
+			return "", err
+		}
+		lanes, err := getLaneSet(conn, endpoint, inputString(context, "laneScheduling") != "weighted")
+		if err != nil {
+			return "", err
+		}
+		publish = func(endpoint string, fields map[string]interface{}) error {
+			return lanes.send(i, fields)
+		}
+	}
+
+	send := sendFunc(func(endpoint string, fields map[string]interface{}) (bool, error) {
+		err := publish(endpoint, fields)
+		if err != nil && sp != nil {
+			log.Warnf("Send to endpoint [%s] failed, spooling: %v", endpoint, err)
+			data, encErr := encodeMessage(nil, fields)
+			if encErr != nil {
+				return false, encErr
+			}
+			return true, sp.append(endpoint, data)
+		}
+		return true, err
+	})
+	if async {
+		sender, err := getAsyncSender(conn, endpoint)
+		if err != nil {
+			return "", err
+		}
+		send = func(endpoint string, fields map[string]interface{}) (bool, error) {
+			return sender.send(fields, sp)
+		}
+	}
+	group := inputString(context, "group")
+	if group != "" {
+		p, err := getSingletonPublisher(conn, group, inputFloat(context, "activationInterval", 0), inputInt(context, "standbyBuffer", 0))
+		if err != nil {
+			return "", err
+		}
+		next := send
+		send = func(endpoint string, fields map[string]interface{}) (bool, error) {
+			return p.send(endpoint, fields, next)
+		}
+	}
+
+	if interval := inputInt(context, "conflationInterval", 0); interval > 0 {
+		key := inputString(context, "conflationKey")
+		if key == "" {
+			return "", fmt.Errorf("conflation of endpoint [%s] requires a conflation key", endpoint)
+		}
+		c := getConflater(conn, endpoint, group, time.Duration(interval)*time.Millisecond)
+		replaced, err := c.add(key, fields, send)
+		if err != nil {
+			return "", err
+		}
+		if replaced {
+			return "message replaced the pending message of key " + key, nil
+		}
+		return "message of key " + key + " queued for the next flush", nil
+	}
+
+	sent, err := send(endpoint, fields)
+	if err != nil {
+		return "", err
+	}
+	if !sent {
+		return "standby member of group " + group + ", message not sent", nil
+	}
+	return "The Flogo engine sent the message " + message + " to the url" + url, nil
+}
+
+// spoolSend keeps the message in the spool until the realm can be reached again
+func spoolSend(sp *spool, endpoint string, fields map[string]interface{}) (result string, err error) {
+	data, err := encodeMessage(nil, fields)
+	if err != nil {
+		return "", err
+	}
+	if err := sp.append(endpoint, data); err != nil {
+		return "", err
+	}
+	return "realm unreachable, message spooled for replay", nil
+}
+
+// evalFanOut sends the message to every realm of urls at once, each through its own pooled
+// connection, and outputs the outcome per realm in url order. It fails only when no realm
+// took the message.
+func evalFanOut(context activity.Context, urls []string, message string) (done bool, err error) {
+	outcomes := make([]map[string]interface{}, len(urls))
+	var wg sync.WaitGroup
+	for i, url := range urls {
+		wg.Add(1)
+		go func(i int, url string) {
+			defer wg.Done()
+			result, err := pooledSend(context, url, message)
+			outcome := map[string]interface{}{"url": url, "sent": err == nil, "result": result}
+			if err != nil {
+				outcome["error"] = err.Error()
+			}
+			outcomes[i] = outcome
+		}(i, url)
+	}
+	wg.Wait()
+
+	sent := 0
+	for _, outcome := range outcomes {
+		if outcome["sent"] == true {
+			sent++
+		}
+	}
+	if sent == 0 && len(urls) > 0 {
+		return false, fmt.Errorf("message not sent to any of %d realms: %s", len(urls), outcomes[0]["error"])
+	}
+	context.SetOutput("data", outcomes)
+	context.SetOutput("result", fmt.Sprintf("message sent to %d of %d realms", sent, len(urls)))
+	return true, nil
+}
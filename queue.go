@@ -0,0 +1,259 @@
+package FTLogo
+
+import (
+	"fmt"
+	"sync"
+	"time"
+
+	"github.com/TIBCOSoftware/flogo-lib/core/activity"
+)
+
+// Queue is a named event queue whose subscriptions can be added and removed while it
+// dispatches. Handlers registered by name let flows route new subscriptions to them.
+// When the realm server disables the connection, the queue and its subscriptions are
+// created again on the connection that replaces it, keeping their IDs.
+type Queue struct {
+	name string
+	url  string
+
+	// mu also serializes adding subscriptions with moving them to a new connection
+	mu       sync.Mutex
+	queue    *eventQueue
+	handlers map[string]func(fields map[string]interface{}) error
+	subs     map[string]*Subscriber
+	closed   bool
+}
+
+var (
+	queuesMu sync.Mutex
+	queues   = make(map[string]*Queue)
+)
+
+// NewQueue connects to the realm at url and starts dispatching a queue registered under name
+func NewQueue(url, name string) (*Queue, error) {
+	conn, err := getRealm(url)
+	if err != nil {
+		return nil, err
+	}
+
+	queuesMu.Lock()
+	defer queuesMu.Unlock()
+
+	if _, ok := queues[name]; ok {
+		return nil, fmt.Errorf("queue [%s] already exists", name)
+	}
+	eq, err := newEventQueue(conn)
+	if err != nil {
+		return nil, err
+	}
+	q := &Queue{
+		name:     name,
+		url:      url,
+		queue:    eq,
+		handlers: make(map[string]func(fields map[string]interface{}) error),
+		subs:     make(map[string]*Subscriber),
+	}
+	queues[name] = q
+	return q, nil
+}
+
+func findQueue(name string) (*Queue, error) {
+	queuesMu.Lock()
+	defer queuesMu.Unlock()
+
+	q, ok := queues[name]
+	if !ok {
+		return nil, fmt.Errorf("unknown queue [%s]", name)
+	}
+	return q, nil
+}
+
+// Handle registers handler under name as a target of subscriptions added by flows
+func (q *Queue) Handle(name string, handler func(fields map[string]interface{}) error) {
+	q.mu.Lock()
+	defer q.mu.Unlock()
+	q.handlers[name] = handler
+}
+
+// Subscribe adds a subscriber to the running queue; config.URL is ignored
+func (q *Queue) Subscribe(config SubscriberConfig, handler func(fields map[string]interface{}) error) (*Subscriber, error) {
+	if err := config.validate(); err != nil {
+		return nil, err
+	}
+
+	q.mu.Lock()
+	defer q.mu.Unlock()
+
+	if q.closed {
+		return nil, fmt.Errorf("queue [%s] is closed", q.name)
+	}
+	s, err := startSubscriber(q.queue, config, handler)
+	if err != nil {
+		return nil, err
+	}
+	q.subs[s.ID] = s
+	return s, nil
+}
+
+// subscribeHandler adds a subscriber delivering to the handler registered under name
+func (q *Queue) subscribeHandler(name string, config SubscriberConfig) (*Subscriber, error) {
+	q.mu.Lock()
+	handler, ok := q.handlers[name]
+	q.mu.Unlock()
+
+	if !ok {
+		return nil, fmt.Errorf("queue [%s] has no handler [%s]", q.name, name)
+	}
+	return q.Subscribe(config, handler)
+}
+
+// Unsubscribe removes the subscriber with the given ID; the other subscriptions keep receiving
+func (q *Queue) Unsubscribe(id string) error {
+	q.mu.Lock()
+	s, ok := q.subs[id]
+	delete(q.subs, id)
+	q.mu.Unlock()
+
+	if !ok {
+		return fmt.Errorf("queue [%s] has no subscription [%s]", q.name, id)
+	}
+	return s.Close()
+}
+
+// Close removes every subscriber, stops dispatching and unregisters the queue
+func (q *Queue) Close() {
+	queuesMu.Lock()
+	delete(queues, q.name)
+	queuesMu.Unlock()
+
+	q.mu.Lock()
+	subs, queue := q.subs, q.queue
+	q.subs = make(map[string]*Subscriber)
+	q.closed = true
+	q.mu.Unlock()
+
+	closeSubscribers(subs)
+	queue.close()
+}
+
+func closeSubscribers(subs map[string]*Subscriber) {
+	for _, s := range subs {
+		if err := s.Close(); err != nil {
+			log.Warnf("Unable to close subscription [%s]: %v", s.ID, err)
+		}
+	}
+}
+
+// retireQueues moves the queues dispatching on conn to the connection replacing it
+func retireQueues(conn *realmConn) {
+	queuesMu.Lock()
+	defer queuesMu.Unlock()
+
+	for _, q := range queues {
+		q.mu.Lock()
+		moved := q.queue.conn == conn
+		q.mu.Unlock()
+		if moved {
+			go q.resubscribe()
+		}
+	}
+}
+
+// resubscribe connects again, retrying until the queue is moved or closed
+func (q *Queue) resubscribe() {
+	for {
+		conn, err := getRealm(q.url)
+		if err == nil {
+			if err = q.moveTo(conn); err == nil {
+				return
+			}
+		}
+		log.Warnf("Unable to resubscribe queue [%s] on realm [%s]: %v", q.name, q.url, err)
+
+		time.Sleep(spoolRetry)
+		q.mu.Lock()
+		closed := q.closed
+		q.mu.Unlock()
+		if closed {
+			return
+		}
+	}
+}
+
+// moveTo creates the queue and every subscription again on conn, then closes the old ones.
+// Nothing moves unless every subscription could be created.
+func (q *Queue) moveTo(conn *realmConn) error {
+	eq, err := newEventQueue(conn)
+	if err != nil {
+		return err
+	}
+
+	q.mu.Lock()
+	if q.closed || q.queue.conn == conn {
+		q.mu.Unlock()
+		eq.close()
+		return nil
+	}
+	subs := make(map[string]*Subscriber, len(q.subs))
+	for id, s := range q.subs {
+		next, err := startSubscriber(eq, s.config, s.handler)
+		if err != nil {
+			q.mu.Unlock()
+			closeSubscribers(subs)
+			eq.close()
+			return fmt.Errorf("unable to subscribe to endpoint [%s]: %v", s.config.Endpoint, err)
+		}
+		next.ID = id
+		subs[id] = next
+	}
+	old, oldSubs := q.queue, q.subs
+	q.queue, q.subs = eq, subs
+	q.mu.Unlock()
+
+	// a connection retired meanwhile was not seen by retireQueues, so move again
+	if err := conn.checkLive(); err != nil {
+		go q.resubscribe()
+	}
+
+	closeSubscribers(oldSubs)
+	old.close()
+	log.Infof("Queue [%s] resubscribed %d subscriptions on realm [%s]", q.name, len(subs), q.url)
+	return nil
+}
+
+// evalSubscribe adds a subscription to a trigger's queue and outputs its ID
+func evalSubscribe(context activity.Context) (done bool, err error) {
+	q, err := findQueue(inputString(context, "queueName"))
+	if err != nil {
+		return false, err
+	}
+
+	s, err := q.subscribeHandler(inputString(context, "handlerName"), SubscriberConfig{
+		Endpoint:     inputString(context, "endpoint"),
+		Matcher:      inputString(context, "matcher"),
+		Group:        inputString(context, "group"),
+		PartitionKey: inputString(context, "partitionKey"),
+	})
+	if err != nil {
+		return false, err
+	}
+
+	context.SetOutput("data", map[string]interface{}{"subscription": s.ID})
+	context.SetOutput("result", fmt.Sprintf("subscribed to endpoint [%s]", s.config.Endpoint))
+	return true, nil
+}
+
+// evalUnsubscribe removes a subscription added by evalSubscribe
+func evalUnsubscribe(context activity.Context) (done bool, err error) {
+	q, err := findQueue(inputString(context, "queueName"))
+	if err != nil {
+		return false, err
+	}
+	id := inputString(context, "subscription")
+	if err := q.Unsubscribe(id); err != nil {
+		return false, err
+	}
+
+	context.SetOutput("result", fmt.Sprintf("subscription [%s] removed", id))
+	return true, nil
+}
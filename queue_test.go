@@ -0,0 +1,22 @@
+package FTLogo
+
+import (
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func TestQueueRouting(t *testing.T) {
+	_, err := findQueue("missing")
+	assert.NotNil(t, err)
+
+	q := &Queue{name: "q", handlers: make(map[string]func(fields map[string]interface{}) error), subs: make(map[string]*Subscriber)}
+	_, err = q.subscribeHandler("orders", SubscriberConfig{Endpoint: "ep"})
+	assert.NotNil(t, err)
+
+	q.Handle("orders", func(fields map[string]interface{}) error { return nil })
+	_, err = q.subscribeHandler("orders", SubscriberConfig{Endpoint: "ep", Matcher: "not json"})
+	assert.NotNil(t, err)
+
+	assert.NotNil(t, q.Unsubscribe("sub-1"))
+}
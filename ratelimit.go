@@ -0,0 +1,103 @@
+package FTLogo
+
+import (
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+// tokenBucket admits rate messages per second with bursts of up to burst messages. It keeps
+// only the theoretical arrival time of the next message, advanced by compare-and-swap, so
+// taking tokens never locks.
+type tokenBucket struct {
+	interval int64 // nanoseconds per token
+	burst    int64
+	tat      int64
+}
+
+func newTokenBucket(rate, burst int) *tokenBucket {
+	b := &tokenBucket{}
+	b.configure(rate, burst)
+	return b
+}
+
+// configure changes the rate and burst; a burst below one token defaults to one second of rate
+func (b *tokenBucket) configure(rate, burst int) {
+	if burst <= 0 {
+		burst = rate
+	}
+	atomic.StoreInt64(&b.interval, int64(time.Second)/int64(rate))
+	atomic.StoreInt64(&b.burst, int64(burst))
+}
+
+// reserve takes n tokens and returns how long the caller must wait before using them.
+// Reservations are never refused, so waiting callers keep their place in line.
+func (b *tokenBucket) reserve(n int, now time.Time) time.Duration {
+	interval := atomic.LoadInt64(&b.interval)
+	burst := atomic.LoadInt64(&b.burst)
+	t := now.UnixNano()
+	for {
+		tat := atomic.LoadInt64(&b.tat)
+		next := tat
+		if next < t {
+			next = t
+		}
+		next += int64(n) * interval
+		if atomic.CompareAndSwapInt64(&b.tat, tat, next) {
+			if wait := next - t - burst*interval; wait > 0 {
+				return time.Duration(wait)
+			}
+			return 0
+		}
+	}
+}
+
+// take waits until n tokens are available
+func (b *tokenBucket) take(n int) {
+	if b == nil {
+		return
+	}
+	if wait := b.reserve(n, time.Now()); wait > 0 {
+		time.Sleep(wait)
+	}
+}
+
+var rateLimiters sync.Map
+
+// rateLimiter returns the limiter registered under key, configured with rate and burst, or
+// nil when rate is not positive. Lookups of an existing limiter do not lock.
+func rateLimiter(key string, rate, burst int) *tokenBucket {
+	if rate <= 0 {
+		return nil
+	}
+	if b, ok := rateLimiters.Load(key); ok {
+		b := b.(*tokenBucket)
+		b.configure(rate, burst)
+		return b
+	}
+	b, _ := rateLimiters.LoadOrStore(key, newTokenBucket(rate, burst))
+	return b.(*tokenBucket)
+}
+
+// findRateLimiter returns the limiter registered under key, nil if there is none
+func findRateLimiter(key string) *tokenBucket {
+	if b, ok := rateLimiters.Load(key); ok {
+		return b.(*tokenBucket)
+	}
+	return nil
+}
+
+func realmLimiterKey(url string) string {
+	return url
+}
+
+// endpointLimiterKey separates the endpoint with a NUL, which realm urls cannot contain
+func endpointLimiterKey(url, endpoint string) string {
+	return url + "\x00" + endpoint
+}
+
+// takeRate waits for n tokens from the limiters of the endpoint and of its realm
+func takeRate(url, endpoint string, n int) {
+	findRateLimiter(endpointLimiterKey(url, endpoint)).take(n)
+	findRateLimiter(realmLimiterKey(url)).take(n)
+}
@@ -0,0 +1,54 @@
+package FTLogo
+
+import (
+	"sync"
+	"testing"
+	"time"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func TestTokenBucket(t *testing.T) {
+	b := newTokenBucket(10, 3)
+	now := time.Now()
+
+	// the burst goes out at once, then tokens come every 100ms
+	for i := 0; i < 3; i++ {
+		assert.Equal(t, time.Duration(0), b.reserve(1, now))
+	}
+	assert.Equal(t, 100*time.Millisecond, b.reserve(1, now))
+	assert.Equal(t, 300*time.Millisecond, b.reserve(2, now))
+
+	// an idle bucket refills up to the burst only
+	later := now.Add(time.Hour)
+	assert.Equal(t, time.Duration(0), b.reserve(3, later))
+	assert.Equal(t, 100*time.Millisecond, b.reserve(1, later))
+}
+
+func TestTokenBucketConcurrent(t *testing.T) {
+	b := newTokenBucket(1000, 1)
+	now := time.Now()
+
+	var wg sync.WaitGroup
+	for i := 0; i < 100; i++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			b.reserve(1, now)
+		}()
+	}
+	wg.Wait()
+
+	// every reservation advanced the bucket exactly once
+	assert.Equal(t, 100*time.Millisecond, b.reserve(1, now))
+}
+
+func TestRateLimiterRegistry(t *testing.T) {
+	assert.Nil(t, rateLimiter("test-realm", 0, 0))
+	assert.Nil(t, findRateLimiter("test-realm"))
+
+	b := rateLimiter(endpointLimiterKey("test-realm", "ep"), 100, 0)
+	assert.True(t, b == findRateLimiter(endpointLimiterKey("test-realm", "ep")))
+	assert.True(t, b == rateLimiter(endpointLimiterKey("test-realm", "ep"), 50, 0))
+	assert.Nil(t, findRateLimiter("test-realm"))
+}
@@ -0,0 +1,437 @@
+package FTLogo
+
+/*
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "tib/ftl.h"
+
+static void onRealmNotification(tibEx ex, tibRealmNotificationType type, const char *reason, void *closure)
+{
+    char    c = (char)type;
+
+    // wake the Go watcher; the realm is unusable either way so a failed write changes nothing
+    if (write((int)(intptr_t)closure, &c, 1) < 0)
+        return;
+}
+
+static tibRealm connectRealm(tibEx ex, const char *url, const char *secondary, int notifyFd)
+{
+    tibProperties   props = NULL;
+    tibRealm        realm;
+
+    if (secondary)
+    {
+        props = tibProperties_Create(ex);
+        tibProperties_SetString(ex, props, TIB_REALM_PROPERTY_STRING_SECONDARY_SERVER, secondary);
+    }
+
+    // 'default' app is returned if the appName is NULL.
+    realm = tibRealm_Connect(ex, url, NULL, props);
+    if (props)
+        tibProperties_Destroy(ex, props);
+
+    if (realm)
+        tibRealm_SetNotificationHandler(ex, realm, onRealmNotification, (void*)(intptr_t)notifyFd);
+    return realm;
+}
+*/
+import "C"
+
+import (
+	"expvar"
+	"fmt"
+	"os"
+	"strings"
+	"sync"
+	"time"
+	"unsafe"
+)
+
+// ftlError carries the error code and description of a failed FTL call
+type ftlError struct {
+	code int
+	text string
+}
+
+func (e *ftlError) Error() string {
+	return fmt.Sprintf("FTL error %d: %s", e.code, e.text)
+}
+
+// exError converts the state of an exception object into a Go error, nil when no error is set
+func exError(ex C.tibEx) error {
+	code := int(C.tibEx_GetErrorCode(ex))
+	if code == 0 {
+		return nil
+	}
+	buf := make([]byte, 1024)
+	C.tibEx_ToString(ex, (*C.char)(unsafe.Pointer(&buf[0])), C.int(len(buf)))
+	return &ftlError{code: code, text: C.GoString((*C.char)(unsafe.Pointer(&buf[0])))}
+}
+
+var (
+	openOnce sync.Once
+	openErr  error
+)
+
+// openFTL initializes the FTL library once per process
+func openFTL() error {
+	openOnce.Do(func() {
+		ex := C.tibEx_Create()
+		defer C.tibEx_Destroy(ex)
+		C.tib_Open(ex, C.TIB_COMPATIBILITY_VERSION)
+		if openErr = exError(ex); openErr == nil {
+			startFTLLog(ex)
+		}
+	})
+	return openErr
+}
+
+// RealmURL names a connection to the realm server at primary that fails over to the
+// secondary server when one is given. With warm set a standby realm object stays connected
+// to the other server, so a failover swaps it in instead of connecting cold. Warm does not
+// take part in pooling: warm and cold callers of the same servers share one connection,
+// which keeps a standby once any of them asked for it.
+func RealmURL(primary, secondary string, warm bool) string {
+	if secondary == "" {
+		return primary
+	}
+	if warm {
+		return primary + "|" + secondary + "|warm"
+	}
+	return primary + "|" + secondary
+}
+
+// realmKey is the pool key of a realm url, which leaves warm out
+func realmKey(url string) string {
+	primary, secondary, _ := parseRealmURL(url)
+	return RealmURL(primary, secondary, false)
+}
+
+func parseRealmURL(url string) (primary, secondary string, warm bool) {
+	parts := strings.Split(url, "|")
+	primary = parts[0]
+	if len(parts) > 1 {
+		secondary = parts[1]
+	}
+	return primary, secondary, len(parts) > 2 && parts[2] == "warm"
+}
+
+var (
+	realmMetrics   = expvar.NewMap("ftlogo.realm")
+	failoverMicros = new(expvar.Int)
+)
+
+func init() {
+	realmMetrics.Set("lastFailoverMicros", failoverMicros)
+}
+
+// recordFailover publishes the time a connection spent without a usable realm
+func recordFailover(url string, d time.Duration) {
+	realmMetrics.Add("failovers", 1)
+	failoverMicros.Set(int64(d / time.Microsecond))
+	log.Infof("Realm [%s] failed over in %v", url, d)
+}
+
+// realmLink is one realm object, connected to server with other as its secondary, and the
+// pipe its notification handler writes to
+type realmLink struct {
+	realm           C.tibRealm
+	server, other   string
+	notify, notifyW *os.File
+}
+
+func dialRealm(server, other string) (*realmLink, error) {
+	r, w, err := os.Pipe()
+	if err != nil {
+		return nil, err
+	}
+
+	ex := C.tibEx_Create()
+	defer C.tibEx_Destroy(ex)
+
+	curl := C.CString(server)
+	defer C.free(unsafe.Pointer(curl))
+	var csecondary *C.char
+	if other != "" {
+		csecondary = C.CString(other)
+		defer C.free(unsafe.Pointer(csecondary))
+	}
+
+	realm := C.connectRealm(ex, curl, csecondary, C.int(w.Fd()))
+	if err := exError(ex); err != nil {
+		r.Close()
+		w.Close()
+		return nil, err
+	}
+	return &realmLink{realm: realm, server: server, other: other, notify: r, notifyW: w}, nil
+}
+
+// close closes the realm object and its notification pipe
+func (link *realmLink) close() {
+	ex := C.tibEx_Create()
+	defer C.tibEx_Destroy(ex)
+
+	C.tibRealm_Close(ex, link.realm)
+	if err := exError(ex); err != nil {
+		log.Warnf("Unable to close realm [%s]: %v", link.server, err)
+	}
+	link.notify.Close()
+	link.notifyW.Close()
+}
+
+// realmConn is a realm connection shared by every activity instance using the same realm server
+type realmConn struct {
+	url   string
+	realm C.tibRealm
+	link  *realmLink
+	ready chan struct{}
+	err   error
+
+	mu         sync.Mutex
+	publishers map[string]C.tibPublisher
+	matchers   map[string]C.tibContentMatcher
+	queue      *eventQueue
+	standby    *realmLink
+
+	// retired is set once the connection was swapped out or dropped; nothing builds on it again
+	retired bool
+
+	// warm keeps a standby realm object connected; set before the connection is adopted
+	warm bool
+}
+
+// realmRetireGrace is how long calls already in flight on a retired connection have to
+// return before its realm is closed
+const realmRetireGrace = time.Minute
+
+var (
+	realmsMu sync.Mutex
+	realms   = make(map[string]*realmConn)
+
+	// realmFailures remembers when a connection without a standby was lost, to time its replacement
+	realmFailures = make(map[string]time.Time)
+)
+
+// getRealm returns the pooled connection to the realm server at url, connecting on first use.
+// Concurrent callers for the same url wait for the one connect in progress.
+func getRealm(url string) (*realmConn, error) {
+	if err := openFTL(); err != nil {
+		return nil, err
+	}
+	_, _, warm := parseRealmURL(url)
+	url = realmKey(url)
+
+	realmsMu.Lock()
+	conn, ok := realms[url]
+	if !ok {
+		conn = newRealmConn(url)
+		conn.warm = warm
+		realms[url] = conn
+	}
+	realmsMu.Unlock()
+
+	if !ok {
+		conn.connect()
+	}
+	<-conn.ready
+
+	if conn.err != nil {
+		return nil, conn.err
+	}
+	if warm {
+		conn.keepWarm()
+	}
+	return conn, nil
+}
+
+// keepWarm starts a standby for a connection first opened by a cold caller
+func (conn *realmConn) keepWarm() {
+	conn.mu.Lock()
+	start := !conn.warm && !conn.retired
+	conn.warm = true
+	conn.mu.Unlock()
+
+	if start {
+		go conn.warmStandby()
+	}
+}
+
+func newRealmConn(url string) *realmConn {
+	return &realmConn{
+		url:        url,
+		ready:      make(chan struct{}),
+		publishers: make(map[string]C.tibPublisher),
+		matchers:   make(map[string]C.tibContentMatcher),
+	}
+}
+
+func (conn *realmConn) connect() {
+	defer close(conn.ready)
+
+	primary, secondary, _ := parseRealmURL(conn.url)
+	start := time.Now()
+	link, err := dialRealm(primary, secondary)
+	if err != nil && secondary != "" {
+		log.Warnf("Unable to connect to realm server [%s], trying [%s]: %v", primary, secondary, err)
+		if link, err = dialRealm(secondary, primary); err == nil {
+			recordFailover(conn.url, time.Since(start))
+		}
+	}
+	if conn.err = err; err != nil {
+		log.Errorf("Unable to connect to realm server [%s]: %v", conn.url, err)
+
+		// forget the failed attempt so the next caller retries
+		realmsMu.Lock()
+		delete(realms, conn.url)
+		realmsMu.Unlock()
+		return
+	}
+
+	realmsMu.Lock()
+	if failed, ok := realmFailures[conn.url]; ok {
+		delete(realmFailures, conn.url)
+		defer recordFailover(conn.url, time.Since(failed))
+	}
+	realmsMu.Unlock()
+
+	conn.adopt(link)
+}
+
+// adopt makes link the realm of the connection and watches it for notifications
+func (conn *realmConn) adopt(link *realmLink) {
+	conn.realm, conn.link = link.realm, link
+	go conn.watch()
+	if conn.warm {
+		go conn.warmStandby()
+	}
+}
+
+// warmStandby connects a standby realm object to the server the connection is not using,
+// retrying until it succeeds or the connection is replaced
+func (conn *realmConn) warmStandby() {
+	for {
+		link, err := dialRealm(conn.link.other, conn.link.server)
+		if err == nil {
+			conn.mu.Lock()
+			retired := conn.retired
+			if !retired {
+				conn.standby = link
+			}
+			conn.mu.Unlock()
+			if retired {
+				link.close()
+				return
+			}
+			log.Infof("Standby of realm [%s] connected to [%s]", conn.url, link.server)
+			return
+		}
+		log.Warnf("Standby of realm [%s] unable to connect to [%s]: %v", conn.url, conn.link.other, err)
+
+		time.Sleep(spoolRetry)
+		realmsMu.Lock()
+		current := realms[conn.url] == conn
+		realmsMu.Unlock()
+		if !current {
+			return
+		}
+	}
+}
+
+// live fails once the connection is retired; callers hold mu
+func (conn *realmConn) live() error {
+	if conn.retired {
+		return fmt.Errorf("connection to realm [%s] was replaced", conn.url)
+	}
+	return nil
+}
+
+// checkLive fails once the connection is retired
+func (conn *realmConn) checkLive() error {
+	conn.mu.Lock()
+	defer conn.mu.Unlock()
+	return conn.live()
+}
+
+// retire stops what the caches built on a connection that was swapped out or dropped, so
+// the next use builds it again on the current connection, then closes the realm after
+// realmRetireGrace
+func (conn *realmConn) retire() {
+	conn.mu.Lock()
+	conn.retired = true
+	queue := conn.queue
+	conn.queue = nil
+	conn.mu.Unlock()
+
+	retireCaches(conn)
+	if queue != nil {
+		queue.close()
+	}
+	time.AfterFunc(realmRetireGrace, conn.close)
+}
+
+// retireCaches drops the entries of every cache bound to conn, stopping their threads and
+// subscriptions; trigger queues move their subscriptions to the current connection instead
+func retireCaches(conn *realmConn) {
+	retireAsyncSenders(conn)
+	retireLaneSets(conn)
+	retireConflaters(conn)
+	retireSingletons(conn)
+	retireNearCaches(conn)
+	retireLeases(conn)
+	retireMapPools(conn)
+	retireMapScans(conn)
+	retireQueues(conn)
+}
+
+// close closes the realm objects of a retired connection, which frees the publishers and
+// matchers created on them too
+func (conn *realmConn) close() {
+	conn.mu.Lock()
+	defer conn.mu.Unlock()
+
+	conn.publishers, conn.matchers = nil, nil
+	conn.link.close()
+	if conn.standby != nil {
+		conn.standby.close()
+		conn.standby = nil
+	}
+}
+
+// watch waits for the realm server to disable the client, then swaps in the standby realm,
+// or drops the connection from the pool so the next caller reconnects. Either way the
+// disabled connection is retired.
+func (conn *realmConn) watch() {
+	b := make([]byte, 1)
+	if _, err := conn.link.notify.Read(b); err != nil || b[0] != C.TIB_CLIENT_DISABLED {
+		return
+	}
+	start := time.Now()
+	log.Errorf("Realm server [%s] disabled this client", conn.link.server)
+
+	conn.mu.Lock()
+	standby := conn.standby
+	conn.standby = nil
+	conn.mu.Unlock()
+
+	realmsMu.Lock()
+	if realms[conn.url] != conn {
+		realmsMu.Unlock()
+		return
+	}
+	if standby == nil {
+		delete(realms, conn.url)
+		realmFailures[conn.url] = start
+	} else {
+		// only a warm connection has a standby
+		next := newRealmConn(conn.url)
+		next.warm = true
+		next.adopt(standby)
+		close(next.ready)
+		realms[conn.url] = next
+		recordFailover(conn.url, time.Since(start))
+	}
+	realmsMu.Unlock()
+
+	conn.retire()
+}
@@ -0,0 +1,116 @@
+package FTLogo
+
+import (
+	"testing"
+	"time"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func TestRealmURL(t *testing.T) {
+	for _, c := range []struct {
+		primary, secondary string
+		warm               bool
+	}{
+		{"http://a:8080", "", false},
+		{"http://a:8080", "http://b:8080", false},
+		{"http://a:8080", "http://b:8080", true},
+	} {
+		primary, secondary, warm := parseRealmURL(RealmURL(c.primary, c.secondary, c.warm))
+		assert.Equal(t, c.primary, primary)
+		assert.Equal(t, c.secondary, secondary)
+		assert.Equal(t, c.warm && c.secondary != "", warm)
+	}
+
+	// warm standby needs a secondary server to stand by on
+	assert.Equal(t, "http://a:8080", RealmURL("http://a:8080", "", true))
+
+	// warm and cold callers share one pooled connection
+	assert.Equal(t, "http://a:8080|http://b:8080", realmKey(RealmURL("http://a:8080", "http://b:8080", true)))
+	assert.Equal(t, "http://a:8080", realmKey("http://a:8080"))
+}
+
+func TestRecordFailover(t *testing.T) {
+	recordFailover("http://a:8080|http://b:8080", 1500*time.Microsecond)
+	assert.Equal(t, int64(1500), failoverMicros.Value())
+}
+
+func TestRetireCaches(t *testing.T) {
+	old, next := newRealmConn("retire"), newRealmConn("retire")
+
+	sender := &asyncSender{conn: old, endpoint: "ep", queue: make(chan asyncMessage, 1)}
+	lanes := &laneSet{conn: old, endpoint: "ep", lanes: []*lane{{queue: make(chan laneMessage, 1)}}}
+	c := &conflater{conn: old, endpoint: "ep", interval: time.Hour, stop: make(chan struct{}), latest: make(map[string]conflated)}
+	go c.run()
+	cache := &nearCache{name: "ep/m", conn: old, subs: make(map[string]*subscription), stop: make(chan struct{}), entries: make(map[string]*cacheEntry)}
+	go cache.sweep()
+	lease := &lockLease{name: "l", conn: old, owner: make(chan struct{}, 1)}
+	pool := &mapPool{conn: old, jobs: make(chan *mapJob)}
+	scan := &mapScan{id: "retire-scan", conn: old, stop: make(chan struct{})}
+	kept := &asyncSender{conn: next, endpoint: "ep", queue: make(chan asyncMessage, 1)}
+
+	asyncSendersMu.Lock()
+	asyncSenders["retire|ep"] = sender
+	asyncSenders["retire|kept"] = kept
+	asyncSendersMu.Unlock()
+	laneSetsMu.Lock()
+	laneSets["retire|ep"] = lanes
+	laneSetsMu.Unlock()
+	conflatersMu.Lock()
+	conflaters["retire|ep"] = c
+	conflatersMu.Unlock()
+	singletonsMu.Lock()
+	singletons["retire|group"] = &singletonPublisher{conn: old}
+	singletonsMu.Unlock()
+	nearCachesMu.Lock()
+	nearCaches["retire|ep/m"] = cache
+	nearCachesMu.Unlock()
+	leasesMu.Lock()
+	leases["retire|l"] = lease
+	leasesMu.Unlock()
+	mapPoolsMu.Lock()
+	mapPools["retire|ep|m|4"] = pool
+	mapPoolsMu.Unlock()
+	scansMu.Lock()
+	scans[scan.id] = scan
+	scansMu.Unlock()
+
+	old.retired = true
+	retireCaches(old)
+
+	// nothing of the swapped out connection is found again, so the next use rebuilds it
+	assert.True(t, asyncSenders["retire|ep"] == nil)
+	assert.True(t, asyncSenders["retire|kept"] == kept)
+	assert.True(t, laneSets["retire|ep"] == nil)
+	assert.True(t, conflaters["retire|ep"] == nil)
+	assert.True(t, singletons["retire|group"] == nil)
+	assert.True(t, nearCaches["retire|ep/m"] == nil)
+	assert.True(t, leases["retire|l"] == nil)
+	assert.True(t, mapPools["retire|ep|m|4"] == nil)
+	assert.True(t, scans[scan.id] == nil)
+	assert.Equal(t, int32(1), scan.retired)
+	delete(asyncSenders, "retire|kept")
+
+	// flows still holding the retired entries fail instead of using the disabled realm
+	_, err := sender.send(map[string]interface{}{"n": int64(1)}, nil)
+	assert.NotNil(t, err)
+	assert.NotNil(t, lanes.send(0, map[string]interface{}{"n": int64(1)}))
+	results := pool.run(mapOpGet, []string{"k"}, nil, nil)
+	assert.NotNil(t, results[0].(map[string]interface{})["error"])
+	assert.NotNil(t, lease.check("", 0))
+	assert.NotNil(t, old.checkLive())
+	assert.Nil(t, next.checkLive())
+
+	// the conflater stops once it has flushed
+	send := func(endpoint string, fields map[string]interface{}) (bool, error) { return true, nil }
+	for i := 0; i < 100; i++ {
+		if _, err = c.add("k", nil, send); err != nil {
+			break
+		}
+		time.Sleep(time.Millisecond)
+	}
+	assert.NotNil(t, err)
+
+	_, err = getAsyncSender(old, "ep")
+	assert.NotNil(t, err)
+}
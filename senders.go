@@ -0,0 +1,171 @@
+package FTLogo
+
+/*
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdlib.h>
+#include "ftlogo.h"
+
+// Builds a message from its encoding and sends it, returning 0 or -1 on a malformed encoding
+int ftlogoSendEncoded(tibEx ex, tibRealm realm, tibPublisher pub, const char *data, int len)
+{
+    ftlogoReader    r = { data, len, 0 };
+    tibMessage      msg;
+    int             bad;
+
+    msg = ftlogoMessage_Decode(ex, realm, &r, &bad);
+    if (msg == NULL)
+        return bad ? -1 : 0;
+    tibPublisher_Send(ex, pub, msg);
+    tibMessage_Destroy(ex, msg);
+    return 0;
+}
+
+static int pinThread(int cpu)
+{
+    cpu_set_t   set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);
+}
+*/
+import "C"
+
+import (
+	"errors"
+	"hash/fnv"
+	"os"
+	"runtime"
+	"strconv"
+	"strings"
+	"sync"
+	"unsafe"
+)
+
+const (
+	// sendersEnv sets the number of sender threads, 4 by default
+	sendersEnv = "FTLOGO_SENDERS"
+
+	// senderCPUsEnv lists the CPUs the sender threads are pinned to, one per thread in order
+	senderCPUsEnv = "FTLOGO_SENDER_CPUS"
+)
+
+// sendJob is one message handed to a sender thread
+type sendJob struct {
+	conn     *realmConn
+	endpoint string
+	data     []byte
+	done     chan error
+}
+
+// senderWorker publishes on one locked OS thread, reusing its exception object and a C
+// buffer for the message encoding. Every endpoint of a realm maps to one worker, so each
+// publisher is only ever used from the thread that owns it.
+//
+// Endpoints sharing a worker share its single queue: a send blocked on a slow endpoint
+// holds up the others behind it. That is deliberate. Queueing per endpoint would not help
+// while the thread itself is stuck in the send, and a thread per endpoint would give up the
+// bounded, pinned set of sender threads. Endpoints that must not wait on each other can be
+// spread with a larger FTLOGO_SENDERS, or sent through their own async sender or lanes,
+// which have threads of their own.
+type senderWorker struct {
+	jobs chan sendJob
+	cpu  int
+}
+
+var (
+	sendersOnce sync.Once
+	senders     []*senderWorker
+	sendDone    = sync.Pool{New: func() interface{} { return make(chan error, 1) }}
+)
+
+func startSenders() {
+	n, err := strconv.Atoi(os.Getenv(sendersEnv))
+	if err != nil || n <= 0 {
+		n = 4
+	}
+	cpus := parseCPUs(os.Getenv(senderCPUsEnv))
+
+	senders = make([]*senderWorker, n)
+	for i := range senders {
+		w := &senderWorker{jobs: make(chan sendJob, 256), cpu: -1}
+		if i < len(cpus) {
+			w.cpu = cpus[i]
+		}
+		senders[i] = w
+		go w.run()
+	}
+}
+
+// parseCPUs reads a comma separated list of CPU numbers, skipping anything else
+func parseCPUs(list string) []int {
+	var cpus []int
+	for _, s := range strings.Split(list, ",") {
+		if cpu, err := strconv.Atoi(strings.TrimSpace(s)); err == nil && cpu >= 0 {
+			cpus = append(cpus, cpu)
+		}
+	}
+	return cpus
+}
+
+// senderIndex picks the worker owning the publisher of endpoint on the realm at url
+func senderIndex(url, endpoint string, n int) int {
+	h := fnv.New32a()
+	h.Write([]byte(url))
+	h.Write([]byte{0})
+	h.Write([]byte(endpoint))
+	return int(h.Sum32() % uint32(n))
+}
+
+// sendOnWorker publishes data through the sender thread owning endpoint and waits for the outcome
+func sendOnWorker(conn *realmConn, endpoint string, data []byte) error {
+	sendersOnce.Do(startSenders)
+
+	done := sendDone.Get().(chan error)
+	senders[senderIndex(conn.url, endpoint, len(senders))].jobs <- sendJob{conn: conn, endpoint: endpoint, data: data, done: done}
+	err := <-done
+	sendDone.Put(done)
+	return err
+}
+
+func (w *senderWorker) run() {
+	runtime.LockOSThread()
+	defer runtime.UnlockOSThread()
+
+	if w.cpu >= 0 {
+		if rc, err := C.pinThread(C.int(w.cpu)); rc != 0 {
+			log.Warnf("Unable to pin sender thread to CPU %d: %v", w.cpu, err)
+		}
+	}
+
+	ex := C.tibEx_Create()
+	defer C.tibEx_Destroy(ex)
+
+	var buf unsafe.Pointer
+	size := 0
+	for job := range w.jobs {
+		if len(job.data) > size {
+			C.free(buf)
+			size = len(job.data) * 2
+			buf = C.malloc(C.size_t(size))
+		}
+		if len(job.data) > 0 {
+			copy((*[1 << 30]byte)(buf)[:len(job.data):len(job.data)], job.data)
+		}
+		job.done <- w.send(ex, job, (*C.char)(buf))
+		C.tibEx_Clear(ex)
+	}
+	C.free(buf)
+}
+
+func (w *senderWorker) send(ex C.tibEx, job sendJob, data *C.char) error {
+	pub, err := job.conn.publisher(job.endpoint)
+	if err != nil {
+		return err
+	}
+	if C.ftlogoSendEncoded(ex, job.conn.realm, pub, data, C.int(len(job.data))) < 0 {
+		return errors.New("malformed message encoding")
+	}
+	return exError(ex)
+}
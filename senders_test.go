@@ -0,0 +1,20 @@
+package FTLogo
+
+import (
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func TestParseCPUs(t *testing.T) {
+	assert.Equal(t, []int{2, 3, 5}, parseCPUs("2, 3,x,-1,5"))
+	assert.Len(t, parseCPUs(""), 0)
+}
+
+func TestSenderIndex(t *testing.T) {
+	// an endpoint always maps to the same worker, and the realm and endpoint stay apart
+	i := senderIndex("http://a:8080", "orders", 4)
+	assert.Equal(t, i, senderIndex("http://a:8080", "orders", 4))
+	assert.True(t, i >= 0 && i < 4)
+	assert.True(t, senderIndex("http://a:8080x", "y", 1<<20) != senderIndex("http://a:8080", "xy", 1<<20))
+}
@@ -0,0 +1,155 @@
+package FTLogo
+
+import (
+	"fmt"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+// bufferedSend is a message a standby kept in case the active member failed before sending
+// it, with the send of the flow that gave it
+type bufferedSend struct {
+	endpoint string
+	fields   map[string]interface{}
+	next     sendFunc
+	at       time.Time
+}
+
+// publisherPreparer creates the publisher of an endpoint ahead of the first send; the realm
+// connection in production
+type publisherPreparer interface {
+	prepare(endpoint string) error
+}
+
+func (conn *realmConn) prepare(endpoint string) error {
+	_, err := conn.publisher(endpoint)
+	return err
+}
+
+// singletonPublisher passes messages on only while this process holds ordinal 1 of its
+// group. Standbys keep the realm connection and publishers open, and buffer their most
+// recent messages so a promoted member can resend what the failed one may have dropped.
+type singletonPublisher struct {
+	conn   *realmConn
+	prep   publisherPreparer
+	member *groupMember
+
+	// messages older than window were sent by the active member before it could have failed
+	window     time.Duration
+	bufferSize int
+
+	mu     sync.Mutex
+	buffer []bufferedSend
+}
+
+var (
+	singletonsMu sync.Mutex
+	singletons   = make(map[string]*singletonPublisher)
+)
+
+// getSingletonPublisher joins the group on first use; activationInterval is in seconds, 0 for the group default.
+// The process is one member of the group, so every flow using it must ask for the same interval and buffer.
+func getSingletonPublisher(conn *realmConn, group string, activationInterval float64, bufferSize int) (*singletonPublisher, error) {
+	window := 5 * time.Second
+	if activationInterval > 0 {
+		window = time.Duration(activationInterval * float64(time.Second))
+	}
+
+	singletonsMu.Lock()
+	defer singletonsMu.Unlock()
+
+	key := conn.url + "|" + group
+	if p, ok := singletons[key]; ok {
+		if p.window != window || p.bufferSize != bufferSize {
+			return nil, fmt.Errorf("group [%s] already joined with activation interval %v and standby buffer %d",
+				group, p.window, p.bufferSize)
+		}
+		return p, nil
+	}
+
+	queue, err := conn.sharedQueue()
+	if err != nil {
+		return nil, err
+	}
+
+	p := &singletonPublisher{conn: conn, prep: conn, bufferSize: bufferSize, window: window}
+	if p.member, err = joinGroup(queue, group, activationInterval, p.onOrdinal); err != nil {
+		return nil, err
+	}
+	singletons[key] = p
+	return p, nil
+}
+
+// retireSingletons leaves the groups joined on conn; the next send joins again on the
+// current connection, as a standby until the group promotes it
+func retireSingletons(conn *realmConn) {
+	singletonsMu.Lock()
+	defer singletonsMu.Unlock()
+
+	for key, p := range singletons {
+		if p.conn == conn {
+			delete(singletons, key)
+			if p.member != nil {
+				p.member.leave()
+			}
+		}
+	}
+}
+
+func (p *singletonPublisher) active() bool {
+	return atomic.LoadInt64(&p.member.ordinal) == 1
+}
+
+// send passes fields on to next when active and otherwise buffers them, reporting whether
+// they were sent
+func (p *singletonPublisher) send(endpoint string, fields map[string]interface{}, next sendFunc) (bool, error) {
+	// standbys create the publisher too, so taking over does not pay for it
+	if err := p.prep.prepare(endpoint); err != nil {
+		return false, err
+	}
+	if p.active() {
+		return next(endpoint, fields)
+	}
+
+	p.mu.Lock()
+	defer p.mu.Unlock()
+
+	if p.bufferSize > 0 {
+		p.buffer = append(p.trimmed(time.Now()), bufferedSend{endpoint: endpoint, fields: fields, next: next, at: time.Now()})
+		if len(p.buffer) > p.bufferSize {
+			p.buffer = p.buffer[len(p.buffer)-p.bufferSize:]
+		}
+	}
+	return false, nil
+}
+
+// trimmed drops buffered messages older than the window
+func (p *singletonPublisher) trimmed(now time.Time) []bufferedSend {
+	i := 0
+	for i < len(p.buffer) && now.Sub(p.buffer[i].at) > p.window {
+		i++
+	}
+	return p.buffer[i:]
+}
+
+// onOrdinal resends the buffered messages when this member becomes the active one
+func (p *singletonPublisher) onOrdinal(ordinal int64) {
+	if ordinal != 1 {
+		return
+	}
+
+	p.mu.Lock()
+	pending := p.trimmed(time.Now())
+	p.buffer = nil
+	p.mu.Unlock()
+
+	if len(pending) > 0 {
+		log.Infof("Group [%s] promoted this member, resending %d buffered messages", p.member.name, len(pending))
+	}
+	for _, b := range pending {
+		if _, err := b.next(b.endpoint, b.fields); err != nil {
+			log.Errorf("Unable to resend buffered message to endpoint [%s]: %v", b.endpoint, err)
+		}
+	}
+}
@@ -0,0 +1,128 @@
+package FTLogo
+
+import (
+	"testing"
+	"time"
+
+	"github.com/stretchr/testify/assert"
+)
+
+// recordingPublisher keeps what a singletonPublisher prepares and passes on
+type recordingPublisher struct {
+	prepared []string
+	sent     []map[string]interface{}
+}
+
+func (r *recordingPublisher) prepare(endpoint string) error {
+	r.prepared = append(r.prepared, endpoint)
+	return nil
+}
+
+func (r *recordingPublisher) send(endpoint string, fields map[string]interface{}) (bool, error) {
+	r.sent = append(r.sent, fields)
+	return true, nil
+}
+
+func TestSingletonStandbyBuffer(t *testing.T) {
+	out := &recordingPublisher{}
+	p := &singletonPublisher{
+		prep:       out,
+		member:     &groupMember{ordinal: 2},
+		window:     time.Minute,
+		bufferSize: 2,
+	}
+
+	for i := 0; i < 3; i++ {
+		sent, err := p.send("ep", map[string]interface{}{"n": int64(i)}, out.send)
+		assert.Nil(t, err)
+		assert.False(t, sent)
+	}
+	assert.Len(t, out.sent, 0)
+	assert.Len(t, out.prepared, 3)
+	assert.Len(t, p.buffer, 2)
+	assert.Equal(t, int64(1), p.buffer[0].fields["n"])
+
+	// messages older than the activation window are assumed sent by the active member
+	p.buffer[0].at = time.Now().Add(-2 * time.Minute)
+	assert.Len(t, p.trimmed(time.Now()), 1)
+}
+
+func TestSingletonPromotion(t *testing.T) {
+	out := &recordingPublisher{}
+	p := &singletonPublisher{
+		prep:       out,
+		member:     &groupMember{ordinal: 2},
+		window:     time.Minute,
+		bufferSize: 10,
+	}
+	p.send("ep", map[string]interface{}{"n": int64(1)}, out.send)
+	p.send("ep", map[string]interface{}{"n": int64(2)}, out.send)
+
+	// another standby ordinal changes nothing
+	p.onOrdinal(3)
+	assert.Len(t, out.sent, 0)
+
+	// promotion resends the buffer in order and empties it
+	p.member.ordinal = 1
+	p.onOrdinal(1)
+	assert.Len(t, out.sent, 2)
+	assert.Equal(t, int64(1), out.sent[0]["n"])
+	assert.Len(t, p.buffer, 0)
+
+	// the active member sends directly
+	sent, err := p.send("ep", map[string]interface{}{"n": int64(3)}, out.send)
+	assert.Nil(t, err)
+	assert.True(t, sent)
+	assert.Equal(t, int64(3), out.sent[2]["n"])
+}
+
+func TestSingletonComposes(t *testing.T) {
+	out := &recordingPublisher{}
+	p := &singletonPublisher{
+		prep:       out,
+		member:     &groupMember{ordinal: 2},
+		window:     time.Minute,
+		bufferSize: 10,
+	}
+
+	// each message is resent through the send of the flow that gave it, such as its lane
+	// or its spool
+	var spooled []map[string]interface{}
+	spool := func(endpoint string, fields map[string]interface{}) (bool, error) {
+		spooled = append(spooled, fields)
+		return true, nil
+	}
+	p.send("ep", map[string]interface{}{"n": int64(1)}, out.send)
+	p.send("ep", map[string]interface{}{"n": int64(2)}, spool)
+
+	p.member.ordinal = 1
+	p.onOrdinal(1)
+	assert.Len(t, out.sent, 1)
+	assert.Len(t, spooled, 1)
+	assert.Equal(t, int64(2), spooled[0]["n"])
+
+	// an active member reports what its send reported
+	sent, err := p.send("ep", nil, func(endpoint string, fields map[string]interface{}) (bool, error) {
+		return false, nil
+	})
+	assert.Nil(t, err)
+	assert.False(t, sent)
+}
+
+func TestSingletonSettingsMismatch(t *testing.T) {
+	conn := newRealmConn("mismatch")
+	p := &singletonPublisher{conn: conn, window: 5 * time.Second, bufferSize: 10}
+	singletonsMu.Lock()
+	singletons["mismatch|group"] = p
+	singletonsMu.Unlock()
+	defer delete(singletons, "mismatch|group")
+
+	// the process is one member of the group, so later flows must agree with the first
+	found, err := getSingletonPublisher(conn, "group", 0, 10)
+	assert.Nil(t, err)
+	assert.True(t, found == p)
+	_, err = getSingletonPublisher(conn, "group", 2, 10)
+	assert.NotNil(t, err)
+	_, err = getSingletonPublisher(conn, "group", 5, 20)
+	assert.NotNil(t, err)
+}
@@ -0,0 +1,438 @@
+package FTLogo
+
+import (
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"hash/crc32"
+	"hash/fnv"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"sort"
+	"strings"
+	"sync"
+	"syscall"
+	"time"
+	"unsafe"
+)
+
+const (
+	spoolSegmentSize = 64 << 20
+	spoolBudget      = 1 << 30
+	spoolRetry       = 5 * time.Second
+	spoolSuffix      = ".spool"
+
+	// a record header is the payload length, its CRC32C, the record sequence and the
+	// spool time in Unix nanoseconds, all little endian
+	spoolHeaderSize = 24
+)
+
+var (
+	errSpoolFull = errors.New("spool disk budget exhausted")
+	crc32c       = crc32.MakeTable(crc32.Castagnoli)
+)
+
+// spoolWrite is a record waiting for the next group commit
+type spoolWrite struct {
+	record []byte
+	done   chan error
+}
+
+// spool is an append-only store of messages that could not be sent to one realm.
+// Segments are fixed-size files mapped into memory: appending a record is a copy into the
+// map, and every commit syncs the range written since the previous one, so concurrent
+// senders share the msync. While the spool holds records every new message is spooled
+// behind them, and a replay loop scans the closed segments in order once the realm is back,
+// deleting each one it completes. Delivery is at least once: a crash during replay resends
+// the current segment.
+type spool struct {
+	url    string
+	dir    string
+	budget int64
+
+	mu      sync.Mutex
+	size    int64
+	writes  []spoolWrite
+	seq     uint64
+	file    *os.File
+	seg     []byte
+	fileSeq int
+	off     int
+	synced  int
+	commit  chan struct{}
+
+	// sequence of the last record replayed, so a paused replay resumes without resending
+	replayed uint64
+}
+
+// spoolRecord lays out the payload of a record, the endpoint as a length-prefixed string
+// followed by the message encoding, behind room for its header
+func spoolRecord(endpoint string, data []byte) []byte {
+	record := make([]byte, spoolHeaderSize+4, spoolHeaderSize+4+len(endpoint)+len(data))
+	binary.LittleEndian.PutUint32(record[spoolHeaderSize:], uint32(len(endpoint)))
+	record = append(record, endpoint...)
+	return append(record, data...)
+}
+
+// sealSpoolRecord fills in the header of a record
+func sealSpoolRecord(record []byte, seq uint64, at time.Time) {
+	payload := record[spoolHeaderSize:]
+	binary.LittleEndian.PutUint32(record, uint32(len(payload)))
+	binary.LittleEndian.PutUint32(record[4:], crc32.Checksum(payload, crc32c))
+	binary.LittleEndian.PutUint64(record[8:], seq)
+	binary.LittleEndian.PutUint64(record[16:], uint64(at.UnixNano()))
+}
+
+// spoolEntry is a record read back from a segment
+type spoolEntry struct {
+	seq      uint64
+	at       time.Time
+	endpoint string
+	data     []byte
+	size     int
+}
+
+// scanSpoolSegment returns the records of a segment in order. The scan stops at the zeroed
+// tail of the segment or at the first record whose checksum fails, which a crash tore.
+func scanSpoolSegment(seg []byte) (entries []spoolEntry, torn bool) {
+	for off := 0; off+spoolHeaderSize <= len(seg); {
+		n := int(binary.LittleEndian.Uint32(seg[off:]))
+		if n == 0 {
+			return entries, false
+		}
+		end := off + spoolHeaderSize + n
+		if n < 4 || end > len(seg) {
+			return entries, true
+		}
+		payload := seg[off+spoolHeaderSize : end]
+		if crc32.Checksum(payload, crc32c) != binary.LittleEndian.Uint32(seg[off+4:]) {
+			return entries, true
+		}
+		e := int(binary.LittleEndian.Uint32(payload))
+		if 4+e > n {
+			return entries, true
+		}
+		entries = append(entries, spoolEntry{
+			seq:      binary.LittleEndian.Uint64(seg[off+8:]),
+			at:       time.Unix(0, int64(binary.LittleEndian.Uint64(seg[off+16:]))),
+			endpoint: string(payload[4 : 4+e]),
+			data:     payload[4+e:],
+			size:     spoolHeaderSize + n,
+		})
+		off = end
+	}
+	return entries, false
+}
+
+var (
+	spoolsMu sync.Mutex
+	spools   = make(map[string]*spool)
+)
+
+// getSpool opens the spool of url under dir, replaying what an earlier run left behind
+func getSpool(dir, url string, budget int64) (*spool, error) {
+	spoolsMu.Lock()
+	defer spoolsMu.Unlock()
+
+	key := realmKey(url) + "|" + dir
+	if s, ok := spools[key]; ok {
+		return s, nil
+	}
+
+	h := fnv.New64a()
+	h.Write([]byte(realmKey(url)))
+	s := &spool{url: url, dir: filepath.Join(dir, fmt.Sprintf("%016x", h.Sum64())), budget: budget, commit: make(chan struct{}, 1)}
+	if s.budget <= 0 {
+		s.budget = spoolBudget
+	}
+	if err := os.MkdirAll(s.dir, 0755); err != nil {
+		return nil, err
+	}
+
+	segments, err := s.segments()
+	if err != nil {
+		return nil, err
+	}
+	for _, seg := range segments {
+		err := readSpoolSegment(seg.path, func(entries []spoolEntry, torn bool) {
+			for _, e := range entries {
+				s.size += int64(e.size)
+				if e.seq > s.seq {
+					s.seq = e.seq
+				}
+			}
+		})
+		if err != nil {
+			return nil, err
+		}
+		s.fileSeq = seg.seq + 1
+	}
+	if s.size > 0 {
+		log.Infof("Spool of [%s] holds %d bytes from an earlier run", url, s.size)
+	}
+
+	go s.committer()
+	go s.replayer()
+	spools[key] = s
+	return s, nil
+}
+
+type spoolSegment struct {
+	seq  int
+	path string
+}
+
+// segments lists the segment files in sequence order
+func (s *spool) segments() ([]spoolSegment, error) {
+	names, err := ioutil.ReadDir(s.dir)
+	if err != nil {
+		return nil, err
+	}
+	var segments []spoolSegment
+	for _, info := range names {
+		var seq int
+		if !strings.HasSuffix(info.Name(), spoolSuffix) {
+			continue
+		}
+		if _, err := fmt.Sscanf(info.Name(), "%d"+spoolSuffix, &seq); err == nil {
+			segments = append(segments, spoolSegment{seq: seq, path: filepath.Join(s.dir, info.Name())})
+		}
+	}
+	sort.Slice(segments, func(i, j int) bool { return segments[i].seq < segments[j].seq })
+	return segments, nil
+}
+
+// pending reports whether messages wait in the spool, so new ones must queue behind them
+func (s *spool) pending() bool {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	return s.size > 0
+}
+
+// append spools a message and returns once it is on disk
+func (s *spool) append(endpoint string, data []byte) error {
+	w := spoolWrite{record: spoolRecord(endpoint, data), done: make(chan error, 1)}
+	if len(w.record) > spoolSegmentSize {
+		return fmt.Errorf("message of %d bytes does not fit a spool segment", len(w.record))
+	}
+
+	s.mu.Lock()
+	if s.size+int64(len(w.record)) > s.budget {
+		s.mu.Unlock()
+		return errSpoolFull
+	}
+	s.size += int64(len(w.record))
+	s.writes = append(s.writes, w)
+	s.mu.Unlock()
+
+	select {
+	case s.commit <- struct{}{}:
+	default:
+	}
+	return <-w.done
+}
+
+// committer writes and syncs every record queued since its last commit
+func (s *spool) committer() {
+	for range s.commit {
+		s.mu.Lock()
+		writes := s.writes
+		s.writes = nil
+		s.mu.Unlock()
+
+		// records that reached a segment will be replayed, so only the others fail and leave the size
+		written, err := s.write(writes)
+		for i, w := range writes {
+			if i < written {
+				w.done <- nil
+				continue
+			}
+			s.mu.Lock()
+			s.size -= int64(len(w.record))
+			s.mu.Unlock()
+			w.done <- err
+		}
+	}
+}
+
+// write copies records into the mapped segment and syncs the range they cover, returning
+// how many records were copied before an error
+func (s *spool) write(writes []spoolWrite) (int, error) {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+
+	now := time.Now()
+	for i, w := range writes {
+		if s.seg == nil || s.off+len(w.record) > len(s.seg) {
+			if err := s.rotate(); err != nil {
+				return i, err
+			}
+		}
+		s.seq++
+		sealSpoolRecord(w.record, s.seq, now)
+		s.off += copy(s.seg[s.off:], w.record)
+	}
+	return len(writes), s.sync()
+}
+
+// sync flushes the part of the segment written since the last sync; callers hold mu
+func (s *spool) sync() error {
+	if s.seg == nil || s.synced == s.off {
+		return nil
+	}
+	// msync wants a page aligned address
+	from := s.synced &^ (os.Getpagesize() - 1)
+	if err := msync(s.seg[from:s.off]); err != nil {
+		return err
+	}
+	s.synced = s.off
+	return nil
+}
+
+// rotate closes the current segment and maps a new zeroed one; callers hold mu
+func (s *spool) rotate() error {
+	if err := s.closeSegment(); err != nil {
+		return err
+	}
+	f, err := os.OpenFile(filepath.Join(s.dir, fmt.Sprintf("%016d%s", s.fileSeq, spoolSuffix)), os.O_CREATE|os.O_RDWR|os.O_TRUNC, 0644)
+	if err != nil {
+		return err
+	}
+	if err := f.Truncate(spoolSegmentSize); err != nil {
+		f.Close()
+		return err
+	}
+	seg, err := syscall.Mmap(int(f.Fd()), 0, spoolSegmentSize, syscall.PROT_READ|syscall.PROT_WRITE, syscall.MAP_SHARED)
+	if err != nil {
+		f.Close()
+		return err
+	}
+	s.file, s.seg, s.fileSeq, s.off, s.synced = f, seg, s.fileSeq+1, 0, 0
+	return nil
+}
+
+// closeSegment syncs and unmaps the segment being written; callers hold mu
+func (s *spool) closeSegment() error {
+	if s.seg == nil {
+		return nil
+	}
+	err := s.sync()
+	syscall.Munmap(s.seg)
+	s.file.Close()
+	s.file, s.seg = nil, nil
+	return err
+}
+
+func msync(b []byte) error {
+	if len(b) == 0 {
+		return nil
+	}
+	_, _, errno := syscall.Syscall(syscall.SYS_MSYNC, uintptr(unsafe.Pointer(&b[0])), uintptr(len(b)), syscall.MS_SYNC)
+	if errno != 0 {
+		return errno
+	}
+	return nil
+}
+
+// readSpoolSegment maps a segment read-only and hands its records to fn while the map is held
+func readSpoolSegment(path string, fn func(entries []spoolEntry, torn bool)) error {
+	f, err := os.Open(path)
+	if err != nil {
+		return err
+	}
+	defer f.Close()
+
+	info, err := f.Stat()
+	if err != nil {
+		return err
+	}
+	if info.Size() == 0 {
+		fn(nil, false)
+		return nil
+	}
+	seg, err := syscall.Mmap(int(f.Fd()), 0, int(info.Size()), syscall.PROT_READ, syscall.MAP_SHARED)
+	if err != nil {
+		return err
+	}
+	defer syscall.Munmap(seg)
+
+	fn(scanSpoolSegment(seg))
+	return nil
+}
+
+// replayer sends the spooled messages once the realm can be reached again
+func (s *spool) replayer() {
+	for {
+		if s.pending() {
+			if conn, err := getRealm(s.url); err == nil {
+				err := s.replay(conn)
+				if err == nil {
+					continue
+				}
+				log.Warnf("Replay of spool [%s] paused: %v", s.dir, err)
+			}
+		}
+		time.Sleep(spoolRetry)
+	}
+}
+
+// replay sends every closed segment in order, deleting each one it completes
+func (s *spool) replay(conn *realmConn) error {
+	// close the segment being written so it can be replayed; later records go to a new one
+	s.mu.Lock()
+	if s.off > 0 {
+		if err := s.closeSegment(); err != nil {
+			s.mu.Unlock()
+			return err
+		}
+	}
+	last := s.fileSeq
+	if s.seg != nil {
+		last--
+	}
+	s.mu.Unlock()
+
+	segments, err := s.segments()
+	if err != nil {
+		return err
+	}
+	for _, seg := range segments {
+		if seg.seq >= last {
+			break
+		}
+		if err := s.replaySegment(conn, seg.path); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+// replaySegment scans a segment in order, skipping records a paused replay already sent
+func (s *spool) replaySegment(conn *realmConn, path string) error {
+	var sendErr error
+	err := readSpoolSegment(path, func(entries []spoolEntry, torn bool) {
+		for _, e := range entries {
+			if e.seq <= s.replayed {
+				continue
+			}
+			if sendErr = publishEncoded(conn, e.endpoint, e.data); sendErr != nil {
+				return
+			}
+			s.replayed = e.seq
+			s.mu.Lock()
+			s.size -= int64(e.size)
+			s.mu.Unlock()
+		}
+		if torn {
+			log.Warnf("Spool segment [%s] ends with a torn record", path)
+		}
+	})
+	if err != nil {
+		return err
+	}
+	if sendErr != nil {
+		return sendErr
+	}
+	return os.Remove(path)
+}
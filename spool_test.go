@@ -0,0 +1,127 @@
+package FTLogo
+
+import (
+	"io/ioutil"
+	"os"
+	"sync"
+	"testing"
+	"time"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func TestSpoolAppend(t *testing.T) {
+	dir, err := ioutil.TempDir("", "spool")
+	assert.Nil(t, err)
+	defer os.RemoveAll(dir)
+
+	s := &spool{dir: dir, budget: 1 << 20, commit: make(chan struct{}, 1)}
+	go s.committer()
+
+	// concurrent senders share commits
+	var wg sync.WaitGroup
+	for i := 0; i < 20; i++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			assert.Nil(t, s.append("ep", []byte("payload")))
+		}()
+	}
+	wg.Wait()
+	assert.True(t, s.pending())
+	assert.Equal(t, int64(20*(spoolHeaderSize+4+2+7)), s.size)
+
+	segments, err := s.segments()
+	assert.Nil(t, err)
+	assert.Len(t, segments, 1)
+
+	err = readSpoolSegment(segments[0].path, func(entries []spoolEntry, torn bool) {
+		assert.False(t, torn)
+		assert.Len(t, entries, 20)
+		for i, e := range entries {
+			assert.Equal(t, uint64(i+1), e.seq)
+			assert.Equal(t, "ep", e.endpoint)
+			assert.Equal(t, "payload", string(e.data))
+		}
+	})
+	assert.Nil(t, err)
+
+	s.budget = s.size
+	assert.Equal(t, errSpoolFull, s.append("ep", []byte("x")))
+}
+
+func TestScanSpoolSegmentTorn(t *testing.T) {
+	seg := make([]byte, 256)
+	first := spoolRecord("ep", []byte("payload"))
+	sealSpoolRecord(first, 1, time.Now())
+	second := spoolRecord("ep", []byte("payload"))
+	sealSpoolRecord(second, 2, time.Now())
+	n := copy(seg, first)
+	copy(seg[n:], second)
+
+	entries, torn := scanSpoolSegment(seg)
+	assert.False(t, torn)
+	assert.Len(t, entries, 2)
+
+	// a corrupted payload fails its checksum and ends the scan
+	seg[n+len(second)-1] ^= 0xff
+	entries, torn = scanSpoolSegment(seg)
+	assert.True(t, torn)
+	assert.Len(t, entries, 1)
+}
+
+func TestSpoolWritePartial(t *testing.T) {
+	dir, err := ioutil.TempDir("", "spool")
+	assert.Nil(t, err)
+	defer os.RemoveAll(dir)
+
+	s := &spool{dir: dir, budget: 1 << 30, commit: make(chan struct{}, 1)}
+	write := func() spoolWrite {
+		return spoolWrite{record: spoolRecord("ep", []byte("payload")), done: make(chan error, 1)}
+	}
+	n, err := s.write([]spoolWrite{write()})
+	assert.Nil(t, err)
+	assert.Equal(t, 1, n)
+
+	// the first record fills the segment and the rotation for the second one fails
+	s.off = len(s.seg) - len(write().record)
+	assert.Nil(t, os.RemoveAll(dir))
+	n, err = s.write([]spoolWrite{write(), write()})
+	assert.NotNil(t, err)
+	assert.Equal(t, 1, n)
+
+	// through the committer only the record left unwritten sees the error
+	assert.Nil(t, os.MkdirAll(dir, 0755))
+	_, err = s.write([]spoolWrite{write()})
+	assert.Nil(t, err)
+	first, second := write(), write()
+	s.off = len(s.seg) - len(first.record)
+	assert.Nil(t, os.RemoveAll(dir))
+	s.writes = []spoolWrite{first, second}
+	s.size = int64(len(first.record) + len(second.record))
+	go s.committer()
+	s.commit <- struct{}{}
+	assert.Nil(t, <-first.done)
+	assert.NotNil(t, <-second.done)
+	assert.Equal(t, int64(len(first.record)), s.size)
+	close(s.commit)
+}
+
+func TestSpoolPerDirectory(t *testing.T) {
+	first, err := ioutil.TempDir("", "spool")
+	assert.Nil(t, err)
+	defer os.RemoveAll(first)
+	second, err := ioutil.TempDir("", "spool")
+	assert.Nil(t, err)
+	defer os.RemoveAll(second)
+
+	a, err := getSpool(first, "spool-per-directory", 0)
+	assert.Nil(t, err)
+	b, err := getSpool(second, "spool-per-directory", 0)
+	assert.Nil(t, err)
+	assert.True(t, a != b)
+
+	again, err := getSpool(first, "spool-per-directory", 0)
+	assert.Nil(t, err)
+	assert.True(t, a == again)
+}
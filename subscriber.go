@@ -0,0 +1,514 @@
+package FTLogo
+
+/*
+#include <stdlib.h>
+#include <stdint.h>
+#include "ftlogo.h"
+
+// Messages collected by the callbacks of one tibEventQueue_Dispatch call. Every subscriber
+// releases its inbound messages to the callback, so the batch owns them until Go destroys them.
+typedef struct dispatchBatch
+{
+    tibMessage  *msgs;
+    uintptr_t   *subs;
+    int         count;
+    int         cap;
+} dispatchBatch;
+
+static __thread dispatchBatch *currentBatch;
+
+static void onMessages(tibEx ex, tibEventQueue queue, tibint32_t count, tibMessage *msgs, void **closures)
+{
+    dispatchBatch   *batch = currentBatch;
+    int             i;
+
+    if (batch == NULL)
+    {
+        for (i = 0; i < count; i++)
+            tibMessage_Destroy(ex, msgs[i]);
+        return;
+    }
+    if (batch->count + count > batch->cap)
+    {
+        batch->cap = (batch->count + count) * 2;
+        batch->msgs = realloc(batch->msgs, batch->cap * sizeof(tibMessage));
+        batch->subs = realloc(batch->subs, batch->cap * sizeof(uintptr_t));
+    }
+    for (i = 0; i < count; i++)
+    {
+        batch->msgs[batch->count] = msgs[i];
+        batch->subs[batch->count] = (uintptr_t) closures[i];
+        batch->count++;
+    }
+}
+
+// Creates a subscriber that releases inbound messages to the callback and adds it to queue.
+// A durable name makes it durable, and a key field selects the key of a last-value durable.
+static tibSubscriber createSubscriber(tibEx ex, tibRealm realm, tibEventQueue queue,
+                                      const char *endpoint, tibContentMatcher matcher,
+                                      const char *durable, const char *keyField, int explicitAck,
+                                      uintptr_t closure)
+{
+    tibProperties   props;
+    tibSubscriber   sub;
+
+    props = tibProperties_Create(ex);
+    if (durable != NULL)
+        tibProperties_SetString(ex, props, TIB_SUBSCRIBER_PROPERTY_STRING_DURABLE_NAME, durable);
+    if (keyField != NULL)
+        tibProperties_SetString(ex, props, TIB_SUBSCRIBER_PROPERTY_STRING_KEY_FIELD_NAME, keyField);
+    if (explicitAck)
+        tibProperties_SetBoolean(ex, props, TIB_SUBSCRIBER_PROPERTY_BOOL_EXPLICIT_ACK, tibtrue);
+    tibProperties_SetBoolean(ex, props, TIB_SUBSCRIBER_PROPERTY_BOOL_RELEASE_MSGS_TO_CALLBACK, tibtrue);
+    sub = tibSubscriber_Create(ex, realm, endpoint, matcher, props);
+    tibProperties_Destroy(ex, props);
+    tibEventQueue_AddSubscriber(ex, queue, sub, onMessages, (void *) closure);
+    return sub;
+}
+
+static void onRemoved(tibEx ex, tibSubscriber sub, void *closure)
+{
+    tibSubscriber_Close(ex, sub);
+}
+
+// Removes a subscriber from a live queue; FTL closes it once its pending callbacks have returned
+static void removeSubscriber(tibEx ex, tibEventQueue queue, tibSubscriber sub)
+{
+    tibEventQueue_RemoveSubscriber(ex, queue, sub, onRemoved);
+}
+
+// Dispatches the queue once, returning how many messages the callbacks collected into batch
+static int dispatchQueue(tibEx ex, tibEventQueue queue, double timeout, dispatchBatch *batch)
+{
+    batch->count = 0;
+    currentBatch = batch;
+    tibEventQueue_Dispatch(ex, queue, timeout);
+    currentBatch = NULL;
+    return batch->count;
+}
+
+// Encodes the collected messages back to back, returning the length used or needed
+static int encodeBatch(tibEx ex, dispatchBatch *batch, char *data, int cap)
+{
+    ftlogoBuf   b = { data, cap, 0 };
+    int         i;
+
+    for (i = 0; i < batch->count; i++)
+        ftlogoMessage_Encode(ex, batch->msgs[i], &b);
+    return b.len;
+}
+
+static tibMessage batchMessage(dispatchBatch *batch, int i)
+{
+    return batch->msgs[i];
+}
+
+static uintptr_t batchSubscriber(dispatchBatch *batch, int i)
+{
+    return batch->subs[i];
+}
+*/
+import "C"
+
+import (
+	"fmt"
+	"runtime"
+	"strconv"
+	"sync"
+	"sync/atomic"
+	"unsafe"
+)
+
+const (
+	dispatchTimeout    = 1.0
+	dispatchBufferSize = 256 * 1024
+)
+
+// inboundMessage is a received message with its fields already decoded for the flow
+type inboundMessage struct {
+	fields map[string]interface{}
+	msg    C.tibMessage
+}
+
+// subscriberConfig describes the interest of one subscription
+type subscriberConfig struct {
+	endpoint string
+	matcher  string
+	durable  string
+	keyField string
+
+	// explicitAck hands the inbound messages to the handler, which must acknowledge
+	// and destroy them; otherwise they are destroyed once the handler returns
+	explicitAck bool
+}
+
+// subscription delivers the messages of one FTL subscriber to its handler.
+// Messages are destroyed once the handler returns, unless the handler owns them.
+type subscription struct {
+	id      uintptr
+	owned   bool
+	queue   *eventQueue
+	sub     C.tibSubscriber
+	handler func(msgs []*inboundMessage)
+}
+
+// eventQueue owns one FTL event queue and the thread dispatching it
+type eventQueue struct {
+	conn  *realmConn
+	queue C.tibEventQueue
+	mu    sync.Mutex
+	subs  map[uintptr]*subscription
+	stop  chan struct{}
+	done  chan struct{}
+}
+
+var subscriptionSeq uint64
+
+func newEventQueue(conn *realmConn) (*eventQueue, error) {
+	ex := C.tibEx_Create()
+	defer C.tibEx_Destroy(ex)
+
+	q := &eventQueue{
+		conn:  conn,
+		queue: C.tibEventQueue_Create(ex, conn.realm, nil),
+		subs:  make(map[uintptr]*subscription),
+		stop:  make(chan struct{}),
+		done:  make(chan struct{}),
+	}
+	if err := exError(ex); err != nil {
+		return nil, err
+	}
+
+	go q.dispatch()
+	return q, nil
+}
+
+// sharedQueue returns the event queue used by the activity's own subscribers on this realm
+func (conn *realmConn) sharedQueue() (*eventQueue, error) {
+	conn.mu.Lock()
+	defer conn.mu.Unlock()
+
+	if err := conn.live(); err != nil {
+		return nil, err
+	}
+	if conn.queue == nil {
+		q, err := newEventQueue(conn)
+		if err != nil {
+			return nil, err
+		}
+		conn.queue = q
+	}
+	return conn.queue, nil
+}
+
+// subscribe adds a subscriber to the queue; handler runs on the dispatch thread
+func (q *eventQueue) subscribe(config subscriberConfig, handler func(msgs []*inboundMessage)) (*subscription, error) {
+	ex := C.tibEx_Create()
+	defer C.tibEx_Destroy(ex)
+
+	matcher, err := q.conn.contentMatcher(config.matcher)
+	if err != nil {
+		return nil, err
+	}
+
+	cendpoint := cStringOrNil(config.endpoint)
+	defer C.free(unsafe.Pointer(cendpoint))
+	cdurable := cStringOrNil(config.durable)
+	defer C.free(unsafe.Pointer(cdurable))
+	ckeyField := cStringOrNil(config.keyField)
+	defer C.free(unsafe.Pointer(ckeyField))
+
+	s := &subscription{
+		id:      uintptr(atomic.AddUint64(&subscriptionSeq, 1)),
+		owned:   config.explicitAck,
+		queue:   q,
+		handler: handler,
+	}
+
+	// register first so messages dispatched right after AddSubscriber find their handler
+	q.mu.Lock()
+	q.subs[s.id] = s
+	q.mu.Unlock()
+
+	var explicitAck C.int
+	if config.explicitAck {
+		explicitAck = 1
+	}
+	s.sub = C.createSubscriber(ex, q.conn.realm, q.queue, cendpoint, matcher, cdurable, ckeyField, explicitAck, C.uintptr_t(s.id))
+	if err := exError(ex); err != nil {
+		q.mu.Lock()
+		delete(q.subs, s.id)
+		q.mu.Unlock()
+		if s.sub != nil {
+			C.tibEx_Clear(ex)
+			C.tibSubscriber_Close(ex, s.sub)
+		}
+		return nil, err
+	}
+	return s, nil
+}
+
+// close removes the subscriber from its queue without disturbing the other subscriptions;
+// messages of this subscriber already collected by the dispatch thread are dropped
+func (s *subscription) close() error {
+	s.queue.mu.Lock()
+	delete(s.queue.subs, s.id)
+	s.queue.mu.Unlock()
+
+	ex := C.tibEx_Create()
+	defer C.tibEx_Destroy(ex)
+
+	C.removeSubscriber(ex, s.queue.queue, s.sub)
+	return exError(ex)
+}
+
+// close stops the dispatch thread and destroys the queue
+func (q *eventQueue) close() {
+	close(q.stop)
+	<-q.done
+
+	ex := C.tibEx_Create()
+	defer C.tibEx_Destroy(ex)
+	C.tibEventQueue_Destroy(ex, q.queue, nil)
+}
+
+// dispatch runs the queue on a locked thread, decoding each dispatched batch in one cgo call
+func (q *eventQueue) dispatch() {
+	runtime.LockOSThread()
+	defer runtime.UnlockOSThread()
+	defer close(q.done)
+
+	ex := C.tibEx_Create()
+	defer C.tibEx_Destroy(ex)
+
+	batch := (*C.dispatchBatch)(C.calloc(1, C.sizeof_dispatchBatch))
+	defer func() {
+		C.free(unsafe.Pointer(batch.msgs))
+		C.free(unsafe.Pointer(batch.subs))
+		C.free(unsafe.Pointer(batch))
+	}()
+
+	size := dispatchBufferSize
+	buf := C.malloc(C.size_t(size))
+	defer func() { C.free(buf) }()
+
+	for {
+		select {
+		case <-q.stop:
+			return
+		default:
+		}
+
+		n := int(C.dispatchQueue(ex, q.queue, dispatchTimeout, batch))
+		if err := exError(ex); err != nil {
+			log.Errorf("Event queue dispatch failed: %v", err)
+			C.tibEx_Clear(ex)
+		}
+		if n == 0 {
+			continue
+		}
+
+		used := int(C.encodeBatch(ex, batch, (*C.char)(buf), C.int(size)))
+		if used > size {
+			C.free(buf)
+			size = used * 2
+			buf = C.malloc(C.size_t(size))
+			used = int(C.encodeBatch(ex, batch, (*C.char)(buf), C.int(size)))
+		}
+		q.deliver(ex, batch, n, (*[1 << 30]byte)(buf)[:used:used])
+	}
+}
+
+// deliver groups a dispatched batch by subscription and hands each group to its handler
+func (q *eventQueue) deliver(ex C.tibEx, batch *C.dispatchBatch, n int, data []byte) {
+	r := &fieldReader{data: data}
+	groups := make(map[uintptr][]*inboundMessage)
+	var order []uintptr
+
+	for i := 0; i < n; i++ {
+		m := &inboundMessage{msg: C.batchMessage(batch, C.int(i))}
+		m.fields = r.message()
+		if err := decompressFields(m.fields); err != nil {
+			log.Errorf("Unable to decompress a dispatched message: %v", err)
+		}
+
+		id := uintptr(C.batchSubscriber(batch, C.int(i)))
+		if _, ok := groups[id]; !ok {
+			order = append(order, id)
+		}
+		groups[id] = append(groups[id], m)
+	}
+	if r.err != nil {
+		log.Errorf("Unable to decode dispatched messages: %v", r.err)
+	}
+
+	for _, m := range q.handOff(groups, order, r.err == nil) {
+		C.tibMessage_Destroy(ex, m.msg)
+	}
+}
+
+// handOff passes each group of a decoded batch to its subscription in order and returns
+// the messages still owned by the queue, to be destroyed: those of subscriptions removed
+// meanwhile, of a batch that failed to decode, and those the handler does not own
+func (q *eventQueue) handOff(groups map[uintptr][]*inboundMessage, order []uintptr, decoded bool) []*inboundMessage {
+	var release []*inboundMessage
+	for _, id := range order {
+		q.mu.Lock()
+		s := q.subs[id]
+		q.mu.Unlock()
+		if s != nil && decoded {
+			s.handler(groups[id])
+			// owning handlers acknowledge and destroy their messages themselves
+			if s.owned {
+				continue
+			}
+		}
+		release = append(release, groups[id]...)
+	}
+	return release
+}
+
+// SubscriberConfig describes a subscriber started by the receive trigger
+type SubscriberConfig struct {
+	URL      string
+	Endpoint string
+	Matcher  string
+
+	// Group, when set, joins the named group and delivers only the messages whose
+	// PartitionKey field hashes to this member's ordinal. It cannot be combined with a
+	// Durable: the skipped messages would be consumed from the durable unprocessed.
+	Group        string
+	PartitionKey string
+
+	// Durable, when set, subscribes through the named durable. With ExplicitAck each message
+	// is acknowledged only after its handler returned without error, in batches of AckBatch
+	// from a background thread, with at most MaxUnacked messages awaiting acknowledgement.
+	Durable     string
+	ExplicitAck bool
+	AckBatch    int
+	MaxUnacked  int
+
+	// KeyField, with a last-value Durable, names the field whose latest message per value is kept
+	KeyField string
+}
+
+// Subscriber delivers the messages of one FTL subscriber to a handler
+type Subscriber struct {
+	ID string
+
+	config    SubscriberConfig
+	queue     *eventQueue
+	ownsQueue bool
+	sub       *subscription
+	member    *groupMember
+	acker     *acker
+	handler   func(fields map[string]interface{}) error
+}
+
+// NewSubscriber connects to the realm and starts delivering messages, on an event queue of
+// their own, to handler in arrival order
+func NewSubscriber(config SubscriberConfig, handler func(fields map[string]interface{}) error) (*Subscriber, error) {
+	if err := config.validate(); err != nil {
+		return nil, err
+	}
+	conn, err := getRealm(config.URL)
+	if err != nil {
+		return nil, err
+	}
+	queue, err := newEventQueue(conn)
+	if err != nil {
+		return nil, err
+	}
+
+	s, err := startSubscriber(queue, config, handler)
+	if err != nil {
+		queue.close()
+		return nil, err
+	}
+	s.ownsQueue = true
+	return s, nil
+}
+
+func (config *SubscriberConfig) validate() error {
+	if config.Group != "" && config.PartitionKey == "" {
+		return fmt.Errorf("group [%s] requires a partition key", config.Group)
+	}
+	if config.Group != "" && config.Durable != "" {
+		return fmt.Errorf("group [%s] cannot partition durable [%s]", config.Group, config.Durable)
+	}
+	if config.KeyField != "" && config.Durable == "" {
+		return fmt.Errorf("key field [%s] of endpoint [%s] requires a last-value durable", config.KeyField, config.Endpoint)
+	}
+	if config.ExplicitAck && config.Durable == "" {
+		return fmt.Errorf("explicit acknowledgement of endpoint [%s] requires a durable", config.Endpoint)
+	}
+	if config.Matcher != "" {
+		if _, err := normalizeMatcher(config.Matcher); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+// startSubscriber adds a subscriber for config to a running queue
+func startSubscriber(queue *eventQueue, config SubscriberConfig, handler func(fields map[string]interface{}) error) (*Subscriber, error) {
+	s := &Subscriber{config: config, queue: queue, handler: handler}
+
+	var err error
+	if config.Group != "" {
+		if s.member, err = joinGroup(queue, config.Group, 0, nil); err != nil {
+			return nil, err
+		}
+	}
+	if config.ExplicitAck {
+		s.acker = newAcker(config.Durable, config.AckBatch, config.MaxUnacked)
+	}
+	s.sub, err = queue.subscribe(subscriberConfig{
+		endpoint:    config.Endpoint,
+		matcher:     config.Matcher,
+		durable:     config.Durable,
+		keyField:    config.KeyField,
+		explicitAck: config.ExplicitAck,
+	}, s.onMessages)
+	if err != nil {
+		if s.member != nil {
+			s.member.leave()
+		}
+		if s.acker != nil {
+			s.acker.close()
+		}
+		return nil, err
+	}
+	s.ID = "sub-" + strconv.FormatUint(uint64(s.sub.id), 10)
+	return s, nil
+}
+
+func (s *Subscriber) onMessages(msgs []*inboundMessage) {
+	for _, m := range msgs {
+		// messages of other partitions are skipped; validate keeps groups off durables
+		var err error
+		if s.member == nil || s.member.owns(fmt.Sprint(m.fields[s.config.PartitionKey])) {
+			if err = s.handler(m.fields); err != nil {
+				log.Errorf("Handler of endpoint [%s] failed: %v", s.config.Endpoint, err)
+			}
+		}
+		if s.acker != nil {
+			s.acker.add(m.msg, err == nil)
+		}
+	}
+}
+
+// Close stops delivery and leaves the group if any, destroying the event queue if the subscriber owns it
+func (s *Subscriber) Close() error {
+	err := s.sub.close()
+	if s.member != nil {
+		s.member.leave()
+	}
+	if s.acker != nil {
+		s.acker.close()
+	}
+	if s.ownsQueue {
+		s.queue.close()
+	}
+	return err
+}
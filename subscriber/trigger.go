@@ -0,0 +1,143 @@
+package subscriber
+
+import (
+	"context"
+	"fmt"
+	"strconv"
+
+	"github.com/TIBCOSoftware/flogo-lib/core/action"
+	"github.com/TIBCOSoftware/flogo-lib/core/trigger"
+	"github.com/TIBCOSoftware/flogo-lib/logger"
+	"github.com/kawatoto/FTLogo"
+)
+
+// log is the default package logger
+var log = logger.GetLogger("trigger-ftlogo-subscriber")
+
+// SubscriberFactory creates subscriber triggers
+type SubscriberFactory struct {
+	metadata *trigger.Metadata
+}
+
+// NewFactory creates a new trigger factory
+func NewFactory(md *trigger.Metadata) trigger.Factory {
+	return &SubscriberFactory{metadata: md}
+}
+
+// New implements trigger.Factory.New
+func (f *SubscriberFactory) New(config *trigger.Config) trigger.Trigger {
+	return &SubscriberTrigger{metadata: f.metadata, config: config}
+}
+
+// SubscriberTrigger runs the action of a handler for every message its FTL subscriptions receive.
+// All handlers share one event queue; flows can add and remove subscriptions on it at runtime
+// with the subscribe and unsubscribe operations of the activity, targeting handlers by name.
+type SubscriberTrigger struct {
+	metadata *trigger.Metadata
+	config   *trigger.Config
+	runner   action.Runner
+	queue    *FTLogo.Queue
+}
+
+// Init implements trigger.Trigger.Init
+func (t *SubscriberTrigger) Init(runner action.Runner) {
+	t.runner = runner
+}
+
+// Metadata implements trigger.Trigger.Metadata
+func (t *SubscriberTrigger) Metadata() *trigger.Metadata {
+	return t.metadata
+}
+
+// Start implements trigger.Trigger.Start
+func (t *SubscriberTrigger) Start() error {
+	url, _ := t.config.Settings["url"].(string)
+	secondary, _ := t.config.Settings["secondaryUrl"].(string)
+	warm, _ := t.config.Settings["warmStandby"].(bool)
+	url = FTLogo.RealmURL(url, secondary, warm)
+	name, _ := t.config.Settings["queue"].(string)
+	if name == "" {
+		name = t.config.Id
+	}
+
+	queue, err := FTLogo.NewQueue(url, name)
+	if err != nil {
+		return err
+	}
+	t.queue = queue
+
+	for _, handler := range t.config.Handlers {
+		run := t.runHandler(handler)
+		if name := setting(handler, "name"); name != "" {
+			queue.Handle(name, run)
+		}
+
+		config := FTLogo.SubscriberConfig{
+			Endpoint:     setting(handler, "endpoint"),
+			Matcher:      setting(handler, "matcher"),
+			Group:        setting(handler, "group"),
+			PartitionKey: setting(handler, "partitionKey"),
+			Durable:      setting(handler, "durableName"),
+			KeyField:     setting(handler, "keyField"),
+			ExplicitAck:  setting(handler, "explicitAck") == "true",
+			AckBatch:     intSetting(handler, "ackBatch"),
+			MaxUnacked:   intSetting(handler, "maxUnacked"),
+		}
+		// handlers without an endpoint only receive subscriptions added by flows
+		if config.Endpoint == "" {
+			continue
+		}
+		if _, err := queue.Subscribe(config, run); err != nil {
+			t.Stop()
+			return fmt.Errorf("unable to subscribe to endpoint [%s]: %v", config.Endpoint, err)
+		}
+		log.Infof("Subscribed to endpoint [%s] for action [%s]", config.Endpoint, handler.ActionId)
+	}
+	return nil
+}
+
+// Stop implements trigger.Trigger.Stop
+func (t *SubscriberTrigger) Stop() error {
+	if t.queue != nil {
+		t.queue.Close()
+		t.queue = nil
+	}
+	return nil
+}
+
+// runHandler returns the message handler starting the action of handler
+func (t *SubscriberTrigger) runHandler(handler *trigger.HandlerConfig) func(fields map[string]interface{}) error {
+	act := action.Get(handler.ActionId)
+
+	return func(fields map[string]interface{}) error {
+		attrs, err := t.metadata.OutputsToAttrs(map[string]interface{}{"message": fields}, false)
+		if err != nil {
+			return err
+		}
+		_, _, err = t.runner.Run(trigger.NewContext(context.Background(), attrs), act, handler.ActionId, nil)
+		return err
+	}
+}
+
+func setting(handler *trigger.HandlerConfig, name string) string {
+	switch value := handler.Settings[name].(type) {
+	case string:
+		return value
+	case bool:
+		return strconv.FormatBool(value)
+	}
+	return ""
+}
+
+func intSetting(handler *trigger.HandlerConfig, name string) int {
+	switch value := handler.Settings[name].(type) {
+	case int:
+		return value
+	case float64:
+		return int(value)
+	case string:
+		n, _ := strconv.Atoi(value)
+		return n
+	}
+	return 0
+}
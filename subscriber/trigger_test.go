@@ -0,0 +1,23 @@
+package subscriber
+
+import (
+	"io/ioutil"
+	"testing"
+
+	"github.com/TIBCOSoftware/flogo-lib/core/trigger"
+	"github.com/stretchr/testify/assert"
+)
+
+func getTriggerMetadata() *trigger.Metadata {
+	jsonMetadataBytes, err := ioutil.ReadFile("trigger.json")
+	if err != nil {
+		panic("No Json Metadata found for trigger.json path")
+	}
+	return trigger.NewMetadata(string(jsonMetadataBytes))
+}
+
+func TestCreate(t *testing.T) {
+	f := NewFactory(getTriggerMetadata())
+	tgr := f.New(&trigger.Config{Settings: map[string]interface{}{"url": "http://localhost:8080"}})
+	assert.NotNil(t, tgr)
+}
@@ -0,0 +1,43 @@
+package FTLogo
+
+import (
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func TestEventQueueHandOff(t *testing.T) {
+	var handled []string
+	handler := func(name string) func(msgs []*inboundMessage) {
+		return func(msgs []*inboundMessage) {
+			handled = append(handled, name)
+		}
+	}
+	q := &eventQueue{subs: map[uintptr]*subscription{
+		1: {id: 1, handler: handler("copying")},
+		2: {id: 2, owned: true, handler: handler("owning")},
+	}}
+
+	batch := func() map[uintptr][]*inboundMessage {
+		return map[uintptr][]*inboundMessage{
+			1: {{fields: map[string]interface{}{"n": int64(1)}}, {fields: map[string]interface{}{"n": int64(2)}}},
+			2: {{fields: map[string]interface{}{"n": int64(3)}}},
+			// a subscription removed while the batch was dispatched
+			3: {{fields: map[string]interface{}{"n": int64(4)}}},
+		}
+	}
+
+	// the owning handler keeps its message; the others go back to be destroyed
+	release := q.handOff(batch(), []uintptr{1, 2, 3}, true)
+	assert.Equal(t, []string{"copying", "owning"}, handled)
+	assert.Len(t, release, 3)
+	assert.Equal(t, int64(1), release[0].fields["n"])
+	assert.Equal(t, int64(2), release[1].fields["n"])
+	assert.Equal(t, int64(4), release[2].fields["n"])
+
+	// a batch that failed to decode reaches no handler and is destroyed whole
+	handled = nil
+	release = q.handOff(batch(), []uintptr{1, 2, 3}, false)
+	assert.Len(t, handled, 0)
+	assert.Len(t, release, 4)
+}
@@ -0,0 +1,69 @@
+package FTLogo
+
+import (
+	"os"
+	"strings"
+	"sync"
+	"time"
+)
+
+// warmupEnv lists the realms and endpoints to connect to as soon as the activity is created,
+// as url=endpoint,endpoint entries separated by semicolons. The url may name a secondary
+// server the way RealmURL does.
+const warmupEnv = "FTLOGO_WARMUP"
+
+var warmupOnce sync.Once
+
+// startWarmup opens FTL in the background and, for every configured realm, connects and
+// creates the publishers of its endpoints. Evals arriving earlier wait on the same pooled
+// connect and publisher creation instead of starting their own.
+func startWarmup() {
+	warmupOnce.Do(func() {
+		realms := parseWarmup(os.Getenv(warmupEnv))
+		if len(realms) == 0 {
+			go openFTL()
+			return
+		}
+		for url, endpoints := range realms {
+			go warmUp(url, endpoints)
+		}
+	})
+}
+
+func warmUp(url string, endpoints []string) {
+	start := time.Now()
+	conn, err := getRealm(url)
+	if err != nil {
+		log.Warnf("Warm-up of realm [%s] failed: %v", url, err)
+		return
+	}
+	for _, endpoint := range endpoints {
+		if _, err := conn.publisher(endpoint); err != nil {
+			log.Warnf("Warm-up of endpoint [%s] on realm [%s] failed: %v", endpoint, url, err)
+		}
+	}
+	log.Infof("Realm [%s] warmed up with %d publishers in %v", url, len(endpoints), time.Since(start))
+}
+
+// parseWarmup reads the realms and endpoints of a warm-up specification
+func parseWarmup(spec string) map[string][]string {
+	realms := make(map[string][]string)
+	for _, entry := range strings.Split(spec, ";") {
+		entry = strings.TrimSpace(entry)
+		if entry == "" {
+			continue
+		}
+		url, list := entry, ""
+		if i := strings.Index(entry, "="); i >= 0 {
+			url, list = strings.TrimSpace(entry[:i]), entry[i+1:]
+		}
+		endpoints := realms[url]
+		for _, endpoint := range strings.Split(list, ",") {
+			if endpoint = strings.TrimSpace(endpoint); endpoint != "" {
+				endpoints = append(endpoints, endpoint)
+			}
+		}
+		realms[url] = endpoints
+	}
+	return realms
+}
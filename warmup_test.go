@@ -0,0 +1,18 @@
+package FTLogo
+
+import (
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func TestParseWarmup(t *testing.T) {
+	realms := parseWarmup(" http://a:8080=orders, quotes ; http://b:8080|http://c:8080 ;http://a:8080=fills")
+	assert.Len(t, realms, 2)
+	assert.Equal(t, []string{"orders", "quotes", "fills"}, realms["http://a:8080"])
+	assert.Len(t, realms["http://b:8080|http://c:8080"], 0)
+	_, ok := realms["http://b:8080|http://c:8080"]
+	assert.True(t, ok)
+
+	assert.Len(t, parseWarmup(""), 0)
+}